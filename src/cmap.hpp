@@ -16,10 +16,22 @@
 #include <memory>
 #include <iterator>
 #include <type_traits>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <limits>
+#include <cmath>
+#include <random>
 
 
 namespace tools {
 
+
+enum class connectivity { face, full };
+
+
 namespace { namespace _cmapbase {
 
 
@@ -29,36 +41,164 @@ struct node_t;
 template<class _Tc, size_t _DIM, class _Td>
 using data_vec = std::vector<std::pair<std::array<_Tc, _DIM>, _Td>>;
 
+/*
+    node_arr<_Tc, _DIM, _Td>: the children of a node, with the bounds which cmap tracks over their leafs (NaN if unknown)
+        * _max bounds key(data) from above, if cmap tracks a key
+        * _sum holds the sum of weight(data), if cmap tracks a weight
+        * the bounds are kept per set of children instead of per node, as only nodes with children have them
+*/
+template<class _Tc, size_t _DIM, class _Td>
+struct node_arr : std::array<node_t<_Tc, _DIM, _Td>, (1U << _DIM)>
+    {
+        double _max = std::numeric_limits<double>::quiet_NaN();
+        double _sum = std::numeric_limits<double>::quiet_NaN();
+    };
+
+
+/*
+    Kinds of the pointer held by a node, in the low bits of node_t::_ptr (all pointees are at least 4-byte aligned)
+*/
+constexpr uintptr_t _tag_data     = 1U;
+constexpr uintptr_t _tag_children = 2U;
+constexpr uintptr_t _tag_packed   = 3U;
+constexpr uintptr_t _tag_mask     = 3U;
+
+
 template<class _Tc, size_t _DIM, class _Td>
-using node_arr = std::array<node_t<_Tc, _DIM, _Td>, (1U << _DIM)>;
+inline void _free(node_t<_Tc, _DIM, _Td>& node) noexcept;
 
 
 /*
     node_t<_Tc, _DIM, _Td>:
-        * holds one of _children or _data, but not both
+        * _ptr owns one of data (leaf), children (interior node) or packed bytes (cold leaf), tagged in its low bits
+        * the tagged pointer is accessed through _data(node), _children(node) and _packed(node), which return nullptr for another kind
+        * a leaf with _packed is cold: its items are compressed in _packed, and _count holds their number
         * key = coordinates (std::array<_Tc, _DIM>)
         * value = data (_Td)
         * _Tc of type uint{8,16,32,64,128,256}_t
         * _DIM <= 8U
         * _level indicates which bit of _Tc to check in _child(...)
+        * _count caches the number of elements in the leafs of a node with _children
+        * the bounds on key(data) and weight(data) of a node with _children are held by its node_arr
+        * _referenced is set when a leaf is accessed, and cleared by the clock sweep which compresses idle leafs
+          (leafs start referenced, so the flag only changes on maps which call compress_idle)
 */
 template<class _Tc, size_t _DIM,  class _Td>
 struct node_t
     {
-        node_t<_Tc, _DIM, _Td> *                    _parent;
-        std::unique_ptr<data_vec<_Tc, _DIM, _Td>>   _data;
-        std::unique_ptr<node_arr<_Tc, _DIM, _Td>>   _children;
+        uintptr_t                                   _ptr = 0U;
+        size_t                                      _count;
         uint8_t                                     _level;
+        uint8_t                                     _referenced = 1U;
+
+        node_t() = default;
+        node_t(const node_t&) = delete;
+        node_t& operator=(const node_t&) = delete;
+        ~node_t() { _free(*this); }
     };
 
 
+/*
+    Return the data of a leaf, or nullptr
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline data_vec<_Tc, _DIM, _Td> * _data(const node_t<_Tc, _DIM, _Td>& node) noexcept
+    {
+        return ((node._ptr & _tag_mask) == _tag_data) ? reinterpret_cast<data_vec<_Tc, _DIM, _Td> *>(node._ptr & ~_tag_mask) : nullptr;
+    }
+
+
+/*
+    Return the children of an interior node, or nullptr
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline node_arr<_Tc, _DIM, _Td> * _children(const node_t<_Tc, _DIM, _Td>& node) noexcept
+    {
+        return ((node._ptr & _tag_mask) == _tag_children) ? reinterpret_cast<node_arr<_Tc, _DIM, _Td> *>(node._ptr & ~_tag_mask) : nullptr;
+    }
+
+
+/*
+    Return the compressed bytes of a cold leaf, or nullptr
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline uint8_t * _packed(const node_t<_Tc, _DIM, _Td>& node) noexcept
+    {
+        return ((node._ptr & _tag_mask) == _tag_packed) ? reinterpret_cast<uint8_t *>(node._ptr & ~_tag_mask) : nullptr;
+    }
+
+
+/*
+    Delete the pointee of a node
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _free(node_t<_Tc, _DIM, _Td>& node) noexcept
+    {
+        delete   _data(node);
+        delete   _children(node);
+        delete[] _packed(node);
+        node._ptr = 0U;
+    }
+
+
+/*
+    Let a node own data, children or packed bytes (instead of its current pointee)
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _hold(node_t<_Tc, _DIM, _Td>& node, std::unique_ptr<data_vec<_Tc, _DIM, _Td>> data) noexcept
+    {
+        _free(node);
+        node._ptr = reinterpret_cast<uintptr_t>(data.release()) | _tag_data;
+    }
+
+template<class _Tc, size_t _DIM, class _Td>
+inline void _hold(node_t<_Tc, _DIM, _Td>& node, std::unique_ptr<node_arr<_Tc, _DIM, _Td>> children) noexcept
+    {
+        _free(node);
+        node._ptr = reinterpret_cast<uintptr_t>(children.release()) | _tag_children;
+    }
+
+template<class _Tc, size_t _DIM, class _Td>
+inline void _hold(node_t<_Tc, _DIM, _Td>& node, std::unique_ptr<uint8_t[]> packed) noexcept
+    {
+        _free(node);
+        node._ptr = reinterpret_cast<uintptr_t>(packed.release()) | _tag_packed;
+    }
+
+
+/*
+    Take the data out of a leaf, which is left without pointee
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline std::unique_ptr<data_vec<_Tc, _DIM, _Td>> _release_data(node_t<_Tc, _DIM, _Td>& node) noexcept
+    {
+        assert(_data(node));
+        std::unique_ptr<data_vec<_Tc, _DIM, _Td>> data(_data(node));
+        node._ptr = 0U;
+        return data;
+    }
+
+
+/*
+    Move the pointee of source to target (whose pointee is deleted), and leave source without pointee
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _hand_over(node_t<_Tc, _DIM, _Td>& target, node_t<_Tc, _DIM, _Td>& source) noexcept
+    {
+        _free(target);
+        target._ptr = source._ptr;
+        source._ptr = 0U;
+    }
+
+
 /*
     Sanity check for class types and sizes
 */
 template<class _Tc>
 inline bool _template_checks(const _Tc seven, const size_t DIM)
     {
-        return (std::is_unsigned<_Tc>::value)     // _Tc of type bool or uint{8,16,32,64,128,256}_t
+        return (std::is_unsigned<_Tc>::value      // _Tc of type bool or uint{8,16,32,64,128,256}_t
+             || std::is_same<_Tc, unsigned __int128>::value) // Not unsigned in strict ISO mode
             && (!std::is_same<_Tc, bool>::value)  // _Tc not of type bool
             && (seven == 7U)                      // double check _Tc not of type bool
             && (DIM <= 8U)
@@ -66,6 +206,21 @@ inline bool _template_checks(const _Tc seven, const size_t DIM)
     }
 
 
+/*
+    Check that the dimensions dims ... are smaller than DIM
+*/
+inline constexpr bool _valid_dims(const size_t) noexcept
+    {
+        return true;
+    }
+
+template<class ... _Ts>
+inline constexpr bool _valid_dims(const size_t DIM, const size_t first, const _Ts ... rest) noexcept
+    {
+        return (first < DIM) && _valid_dims(DIM, rest ...);
+    }
+
+
 /*
     Divide the elements of coordinates by 2
     Assumes _Tc to be of type uint{8,16,32,64,128,256}_t
@@ -78,17 +233,245 @@ inline constexpr void _shift(std::array<_Tc, _DIM>& coordinates) noexcept
     }
 
 
+/*
+    Return bit level of element
+*/
+template<class _Tc>
+inline uint32_t _bit(const _Tc element, const uint8_t level) noexcept
+    {
+        return static_cast<uint32_t>((element >> level) & 1U);
+    }
+
+
+/*
+    Return bit level of a 128-bit element from the 64-bit limb which holds it, instead of a double-word shift
+*/
+inline uint32_t _bit(const unsigned __int128 element, const uint8_t level) noexcept
+    {
+        const uint64_t limb = (level < 64U) ? static_cast<uint64_t>(element) : static_cast<uint64_t>(element >> 64U);
+        return static_cast<uint32_t>((limb >> (level & 63U)) & 1U);
+    }
+
+
+/*
+    Return the bits of coordinates[_I, _DIM) at level, each shifted to its place in _bits
+    Unrolled at compile time: every term has a constant shift, so the terms combine without a loop-carried dependency
+*/
+template<size_t _I, class _Tc, size_t _DIM>
+inline typename std::enable_if<(_I == _DIM), uint32_t>::type _gather(const std::array<_Tc, _DIM>&, const uint8_t) noexcept
+    {
+        return 0U;
+    }
+
+template<size_t _I, class _Tc, size_t _DIM>
+inline typename std::enable_if<(_I < _DIM), uint32_t>::type _gather(const std::array<_Tc, _DIM>& coordinates, const uint8_t level) noexcept
+    {
+        return (_bit(coordinates[_I], level) << (_DIM - 1U - _I)) | _gather<_I + 1U>(coordinates, level);
+    }
+
+
+/*
+    Return the bits of coordinates at level, with coordinates[0] as most significant bit
+*/
+template<class _Tc, size_t _DIM>
+inline uint32_t _bits(const std::array<_Tc, _DIM>& coordinates, const uint8_t level) noexcept
+    {
+        return _gather<0U>(coordinates, level);
+    }
+
+
+/*
+    Return whether two coordinates are equal
+    Branch-free over the dimensions, so that the comparison vectorizes (also for the limbs of 128-bit coordinates)
+*/
+template<class _Tc, size_t _DIM>
+inline bool _equal(const std::array<_Tc, _DIM>& left, const std::array<_Tc, _DIM>& right) noexcept
+    {
+        _Tc difference = 0U;
+        for (size_t dim = 0U; dim < _DIM; ++dim)
+            difference |= left[dim] ^ right[dim];
+        return difference == 0U;
+    }
+
+
+/*
+    Return the index of the child of node to which coordinates correspond
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline uint32_t _index(const node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coordinates)
+    {
+        return _bits(coordinates, node._level);
+    }
+
+
 /*
     Return the child of node to which coordinates correspond
 */
 template<class _Tc, size_t _DIM, class _Td>
 inline node_t<_Tc, _DIM, _Td>& _child(const node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coordinates)
     {
-        assert(node._children);
-        uint32_t child_idx = 0U;
-        for (const _Tc& element : coordinates)
-            child_idx = (child_idx << 1U) | ((element >> node._level) & 1U);
-        return (*(node._children))[child_idx];
+        assert(_children(node));
+        return (*(_children(node)))[_index(node, coordinates)];
+    }
+
+
+/*
+    Compare coordinates in Morton order, which is the iteration order of the leafs of the tree
+    The first coordinate holds the most significant bit of each interleaved group
+*/
+template<class _Tc, size_t _DIM>
+inline bool _morton_less(const std::array<_Tc, _DIM>& left, const std::array<_Tc, _DIM>& right) noexcept
+    {
+        size_t dim = 0U;
+        _Tc highest = left[0] ^ right[0];
+        for (size_t idx = 1U; idx < _DIM; ++idx)
+        {
+            const _Tc next = left[idx] ^ right[idx];
+            if ((highest < next) && (highest < (highest ^ next))) // Most significant bit of next is higher
+            {
+                dim = idx;
+                highest = next;
+            }
+        }
+        return left[dim] < right[dim];
+    }
+
+
+/*
+    Append value as varint (7 bits per byte, least significant first)
+*/
+template<class _Tc>
+inline void _varint(std::vector<uint8_t>& bytes, _Tc value)
+    {
+        while (value >= 0x80U)
+        {
+            bytes.push_back(static_cast<uint8_t>(value & 0x7FU) | 0x80U);
+            value >>= 7U;
+        }
+        bytes.push_back(static_cast<uint8_t>(value));
+    }
+
+
+/*
+    Read a varint at pos, and advance pos
+*/
+template<class _Tc>
+inline _Tc _unvarint(const uint8_t *& pos) noexcept
+    {
+        _Tc value = 0U;
+        for (size_t shift = 0U; ; shift += 7U)
+        {
+            value |= static_cast<_Tc>(*pos & 0x7FU) << shift;
+            if ((*(pos++) & 0x80U) == 0U)
+                return value;
+        }
+    }
+
+
+/*
+    Compress the items of a leaf into _packed, which starts with its length in bytes (uint32_t):
+        * the items are sorted in Morton order, and each coordinate is stored as zigzag varint of its difference with the previous item
+        * the payload is stored per byte plane: a constant plane as (0, byte), otherwise as (1, bytes of all items)
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _pack(node_t<_Tc, _DIM, _Td>& node)
+    {
+        static_assert(std::is_trivially_copyable<_Td>::value, "compressed leafs require a trivially copyable _Td");
+        assert(_data(node) && !_packed(node));
+        data_vec<_Tc, _DIM, _Td>& items = *(_data(node));
+        std::sort(items.begin(), items.end(), [](const std::pair<std::array<_Tc, _DIM>, _Td>& left, const std::pair<std::array<_Tc, _DIM>, _Td>& right)
+            { return _morton_less(left.first, right.first); });
+
+        std::vector<uint8_t> bytes(sizeof(uint32_t));
+        std::array<_Tc, _DIM> previous;
+        previous.fill(0U);
+        for (const auto& item : items)
+        {
+            for (size_t dim = 0U; dim < _DIM; ++dim)
+            {
+                const _Tc delta = item.first[dim] - previous[dim];
+                const _Tc sign  = delta >> (8U * sizeof(_Tc) - 1U);
+                _varint(bytes, static_cast<_Tc>(static_cast<_Tc>(delta << 1U) ^ static_cast<_Tc>(0U - sign)));
+            }
+            previous = item.first;
+        }
+        for (size_t plane = 0U; plane < sizeof(_Td); ++plane)
+        {
+            const uint8_t first = reinterpret_cast<const uint8_t *>(&(items[0].second))[plane];
+            bool constant = true;
+            for (const auto& item : items)
+                constant = constant && (reinterpret_cast<const uint8_t *>(&(item.second))[plane] == first);
+            bytes.push_back(constant ? 0U : 1U);
+            if (constant)
+                bytes.push_back(first);
+            else
+            {
+                for (const auto& item : items)
+                    bytes.push_back(reinterpret_cast<const uint8_t *>(&(item.second))[plane]);
+            }
+        }
+
+        const uint32_t length = static_cast<uint32_t>(bytes.size());
+        std::copy(reinterpret_cast<const uint8_t *>(&length), reinterpret_cast<const uint8_t *>(&length) + sizeof(uint32_t), bytes.begin());
+        auto packed = std::make_unique<uint8_t[]>(length);
+        std::copy(bytes.begin(), bytes.end(), packed.get());
+        node._count = items.size();
+        _hold(node, std::move(packed));
+    }
+
+
+/*
+    Decompress the items of a cold leaf into _data
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _unpack(node_t<_Tc, _DIM, _Td>& node)
+    {
+        assert(!_data(node) && _packed(node));
+        // _Td need not be default constructible: the payloads are decoded into raw storage first
+        std::vector<std::array<_Tc, _DIM>> coords(node._count);
+        std::vector<typename std::aligned_storage<sizeof(_Td), alignof(_Td)>::type> payloads(node._count);
+        const uint8_t * pos = _packed(node) + sizeof(uint32_t);
+        std::array<_Tc, _DIM> previous;
+        previous.fill(0U);
+        for (auto& coord : coords)
+        {
+            for (size_t dim = 0U; dim < _DIM; ++dim)
+            {
+                const _Tc zigzag = _unvarint<_Tc>(pos);
+                previous[dim] += static_cast<_Tc>(zigzag >> 1U) ^ static_cast<_Tc>(0U - (zigzag & 1U));
+            }
+            coord = previous;
+        }
+        for (size_t plane = 0U; plane < sizeof(_Td); ++plane)
+        {
+            const bool constant = (*(pos++) == 0U);
+            for (auto& payload : payloads)
+                reinterpret_cast<uint8_t *>(&payload)[plane] = constant ? *pos : *(pos++);
+            if (constant)
+                ++pos;
+        }
+        auto items = std::make_unique<data_vec<_Tc, _DIM, _Td>>();
+        items->reserve(node._count);
+        for (size_t idx = 0U; idx < node._count; ++idx)
+            items->emplace_back(coords[idx], *reinterpret_cast<const _Td *>(&payloads[idx]));
+        _hold(node, std::move(items));
+    }
+
+
+/*
+    Mark a leaf as referenced, and decompress it if it is cold
+    Called on every access of a leaf through a path (lookup, insertion, erasure or iteration)
+    Only stores if compress_idle cleared the flag or packed the leaf, so reads of a map which is never compressed stay read-only
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _touch(const node_t<_Tc, _DIM, _Td>& node)
+    {
+        if (node._referenced && !_packed(node))
+            return;
+        node_t<_Tc, _DIM, _Td>& leaf = const_cast<node_t<_Tc, _DIM, _Td>&>(node);
+        leaf._referenced = 1U;
+        if (_packed(leaf))
+            _unpack(leaf);
     }
 
 
@@ -98,10 +481,28 @@ inline node_t<_Tc, _DIM, _Td>& _child(const node_t<_Tc, _DIM, _Td>& node, const
 template<class _Tc, size_t _DIM, class _Td>
 inline node_t<_Tc, _DIM, _Td>& _leaf(node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coordinates)
     {
-        if (node._children)
-            return _leaf(_child(node, coordinates), coordinates);
-        else
-            return node;
+        node_t<_Tc, _DIM, _Td> * current = &node;
+        for (node_arr<_Tc, _DIM, _Td> * children = _children(*current); children; children = _children(*current))
+            current = &((*children)[_index(*current, coordinates)]);
+        _touch(*current);
+        return *current;
+    }
+
+
+/*
+    Return the node to which coordinates correspond, and push the nodes with children on the way onto path (which holds depth nodes)
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline node_t<_Tc, _DIM, _Td>& _leaf(node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coordinates, node_t<_Tc, _DIM, _Td> ** path, size_t& depth)
+    {
+        node_t<_Tc, _DIM, _Td> * current = &node;
+        for (node_arr<_Tc, _DIM, _Td> * children = _children(*current); children; children = _children(*current))
+        {
+            path[depth++] = current;
+            current = &((*children)[_index(*current, coordinates)]);
+        }
+        _touch(*current);
+        return *current;
     }
 
 
@@ -111,10 +512,10 @@ inline node_t<_Tc, _DIM, _Td>& _leaf(node_t<_Tc, _DIM, _Td>& node, const std::ar
 template<class _Tc, size_t _DIM, class _Td>
 inline typename data_vec<_Tc, _DIM, _Td>::iterator _pair(const node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coordinates)
     {
-        assert(node._data);
-        auto iter = node._data->begin();
-        auto  end = node._data->end();
-        while ((iter != end) && ((*iter).first != coordinates))
+        assert(_data(node));
+        auto iter = _data(node)->begin();
+        auto  end = _data(node)->end();
+        while ((iter != end) && !_equal((*iter).first, coordinates))
             ++iter;
         return iter;
     }
@@ -126,37 +527,50 @@ inline typename data_vec<_Tc, _DIM, _Td>::iterator _pair(const node_t<_Tc, _DIM,
 template<class _Tc, size_t _DIM, class _Td>
 inline size_t _size(const node_t<_Tc, _DIM, _Td>& node)
     {
-        if (node._data)
+        if (_data(node))
         {
-            assert(!node._children);
-            return node._data->size();
+            assert(!_children(node));
+            return _data(node)->size();
         }
         else
         {
-            assert(node._children);
-            size_t number = 0U;
-            for (const auto& child : *(node._children))
-                number += _size(child);
-            return number;
+            assert(_children(node) || _packed(node));
+            return node._count;
         }
     }
 
 
+/*
+    Count the number of elements in the leafs of the node, and check the cached counts on the way
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline size_t _tally(const node_t<_Tc, _DIM, _Td>& node)
+    {
+        if (!_children(node))
+            return _size(node);
+        size_t number = 0U;
+        for (const auto& child : *(_children(node)))
+            number += _tally(child);
+        assert(number == node._count);
+        return number;
+    }
+
+
 /*
     Collect the data items from a node and its children
 */
 template<class _Tc, size_t _DIM, class _Td>
 inline void _collect(const node_t<_Tc, _DIM, _Td>& node, data_vec<_Tc, _DIM, _Td>& result)
     {
-        if (node._data)
+        if (!_children(node))
         {
-            assert(!node._children);
-            result.insert(result.end(), node._data->begin(), node._data->end());
+            _touch(node);
+            result.insert(result.end(), _data(node)->begin(), _data(node)->end());
         }
         else
         {
-            assert(node._children);
-            for (auto& child : *(node._children))
+            assert(_children(node));
+            for (auto& child : *(_children(node)))
                 _collect(child, result);
         }
     }
@@ -168,21 +582,22 @@ inline void _collect(const node_t<_Tc, _DIM, _Td>& node, data_vec<_Tc, _DIM, _Td
 template<class _Tc, size_t _DIM, class _Td>
 inline void _prune(node_t<_Tc, _DIM, _Td>& node)
     {
-        if (node._children)
+        if (_children(node))
         {
-            const size_t number = _size(node); // TODO: Child holds its size to avoid recomputation
+            const size_t number = _size(node);
             if (number <= (1U << _DIM))
             {
-                node._data = std::make_unique<data_vec<_Tc, _DIM, _Td>>();
-                node._data->reserve(number);
-                for (auto& child : *(node._children))
-                    _collect(child, *(node._data));
-                node._children.reset(nullptr);
-                assert(number == node._data->size());
+                auto items = std::make_unique<data_vec<_Tc, _DIM, _Td>>();
+                items->reserve(number);
+                for (auto& child : *(_children(node)))
+                    _collect(child, *items);
+                _hold(node, std::move(items));
+                node._referenced = 1U;
+                assert(number == _data(node)->size());
             }
             else
             {
-                for (auto& child : *(node._children))
+                for (auto& child : *(_children(node)))
                     _prune(child);
             }
         }
@@ -190,102 +605,292 @@ inline void _prune(node_t<_Tc, _DIM, _Td>& node)
 
 
 /*
-    Split a node into children and distribute data
+    Rebuild source into target in depth-first order, with the capacity of the leafs shrunk to fit (cold leafs are handed over compressed)
+    The items are moved, but source keeps its allocations until the caller drops it: the new tree is allocated as a whole before
+    anything is freed, so the allocator does not refill the holes of the old tree in between (the allocator decides the addresses)
 */
 template<class _Tc, size_t _DIM, class _Td>
-inline void _split(node_t<_Tc, _DIM, _Td>& node)
+inline void _compact(node_t<_Tc, _DIM, _Td>& target, node_t<_Tc, _DIM, _Td>& source)
     {
-        assert(node._level != 0U);
-        assert( node._data);
-        assert(!node._children);
-        const uint8_t child_level = node._level - 1U;
-        node._children = std::make_unique<node_arr<_Tc, _DIM, _Td>>();
-        for (auto& newchild : *(node._children))
+        target._count    = source._count;
+        target._level    = source._level;
+        target._referenced = source._referenced;
+        if (_packed(source))
+            _hand_over(target, source);
+        else if (_data(source))
         {
-            newchild._data     = std::make_unique<data_vec<_Tc, _DIM, _Td>>();
-          //newchild._data->reserve(1U << _DIM);
-            newchild._children = nullptr;
-            newchild._parent   = &node;
-            newchild._level    = child_level;
+            auto fresh = std::make_unique<data_vec<_Tc, _DIM, _Td>>();
+            fresh->reserve(_data(source)->size());
+            std::move(_data(source)->begin(), _data(source)->end(), std::back_inserter(*fresh));
+            _hold(target, std::move(fresh));
+        }
+        else
+        {
+            _hold(target, std::make_unique<node_arr<_Tc, _DIM, _Td>>());
+            _children(target)->_max = _children(source)->_max;
+            _children(target)->_sum = _children(source)->_sum;
+            for (size_t idx = 0U; idx < (1U << _DIM); ++idx)
+                _compact((*(_children(target)))[idx], (*(_children(source)))[idx]);
         }
-        for (const auto& item : *(node._data))
-            _child(node, item.first)._data->push_back(std::move(item));
-        node._data.reset(nullptr);
     }
 
 
 /*
-    Insert (coord, data) in the node
+    Clock sweep over the leafs of a node: referenced leafs get a second chance, idle leafs are compressed
+    Return the number of compressed leafs
 */
 template<class _Tc, size_t _DIM, class _Td>
-inline size_t _insert(node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coord, const _Td& data)
+inline size_t _sweep(node_t<_Tc, _DIM, _Td>& node)
     {
-        assert(node._data);
-        for (auto& target : *(node._data))
+        if (_children(node))
         {
-            if (target.first == coord)
-            {
-                merge(target.second, data);
-                return 0U;
-            }
+            size_t number = 0U;
+            for (auto& child : *(_children(node)))
+                number += _sweep(child);
+            return number;
         }
-        if (node._data->size() < (1U << _DIM))
+        if (_packed(node) || _data(node)->empty())
+            return 0U;
+        if (node._referenced)
         {
-            node._data->push_back(std::make_pair(coord, data));
-            return 1U;
+            node._referenced = 0U;
+            return 0U;
         }
-        _split(node);
-        return _insert(_child(node, coord), coord, data);
+        _pack(node);
+        return 1U;
     }
 
 
 /*
-    Emplace (coord, args) in the node
+    Decompress the cold leafs of a node and its children
 */
-template<class _Tc, size_t _DIM, class _Td, class ... _Ts>
-inline size_t _emplace(node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coord, _Ts&& ... args)
+template<class _Tc, size_t _DIM, class _Td>
+inline void _thaw(node_t<_Tc, _DIM, _Td>& node)
     {
-        assert(node._data);
-        for (auto& target : *(node._data))
+        if (_children(node))
         {
-            if (target.first == coord)
-            {
-                merge(target.second, {args ...});
-                return 0U;
-            }
+            for (auto& child : *(_children(node)))
+                _thaw(child);
         }
-        if (node._data->size() < (1U << _DIM))
+        else if (_packed(node))
+            _unpack(node);
+    }
+
+
+/*
+    Heap memory held by the children and data of a node
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline size_t _memory(const node_t<_Tc, _DIM, _Td>& node)
+    {
+        if (_children(node))
         {
-            node._data->emplace_back(std::piecewise_construct, std::forward_as_tuple(coord), std::forward_as_tuple(args ...));
-            return 1U;
+            size_t number = sizeof(node_arr<_Tc, _DIM, _Td>);
+            for (const auto& child : *(_children(node)))
+                number += _memory(child);
+            return number;
         }
-        _split(node);
-        return _emplace(_child(node, coord), coord, args ...);
+        if (_data(node))
+            return sizeof(data_vec<_Tc, _DIM, _Td>) + _data(node)->capacity() * sizeof(std::pair<std::array<_Tc, _DIM>, _Td>);
+        uint32_t length = 0U;
+        std::copy(_packed(node), _packed(node) + sizeof(uint32_t), reinterpret_cast<uint8_t *>(&length));
+        return length;
     }
 
 
 /*
-    Merge pairs with identical coordinates
+    Split a node into children and distribute data
 */
 template<class _Tc, size_t _DIM, class _Td>
-inline size_t _merge(data_vec<_Tc, _DIM, _Td>& data)
+inline void _split(node_t<_Tc, _DIM, _Td>& node)
     {
-        size_t num_merged = 0U;
-        if (data.size() > 1U)
+        assert(node._level != 0U);
+        assert( _data(node));
+        assert(!_children(node));
+        const uint8_t child_level = node._level - 1U;
+        auto items = _release_data(node);
+        _hold(node, std::make_unique<node_arr<_Tc, _DIM, _Td>>());
+        for (auto& newchild : *(_children(node)))
         {
-            auto head = data.begin();
-            auto end  = data.end();
-            while (head != end)
-            {
-                auto& target = *head;
-                ++head;
-                auto iter   = head;
-                auto result = head;
+            _hold(newchild, std::make_unique<data_vec<_Tc, _DIM, _Td>>());
+          //_data(newchild)->reserve(1U << _DIM);
+            newchild._count    = 0U;
+            newchild._level    = child_level;
+            newchild._referenced = 1U;
+        }
+        for (const auto& item : *items)
+            _data(_child(node, item.first))->push_back(std::move(item));
+        node._count = items->size();
+    }
+
+
+/*
+    Build the subtree of the empty leaf node from data items [first, last), which hold distinct coordinates in Morton order
+    Subtrees are built in parallel by OpenMP tasks, if available
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _build(node_t<_Tc, _DIM, _Td>& node, typename data_vec<_Tc, _DIM, _Td>::iterator first, typename data_vec<_Tc, _DIM, _Td>::iterator last)
+    {
+        assert( _data(node));
+        assert(!_children(node));
+        assert(_data(node)->size() == 0U);
+        const size_t number = last - first;
+        if (number <= (1U << _DIM))
+        {
+            _data(node)->assign(std::make_move_iterator(first), std::make_move_iterator(last));
+            return;
+        }
+        _split(node);
+        node._count = number;
+        auto head = first;
+        for (uint32_t idx = 0U; idx < (1U << _DIM); ++idx)
+        {
+            auto tail = std::partition_point(head, last, [&](const std::pair<std::array<_Tc, _DIM>, _Td>& item){ return _index(node, item.first) <= idx; });
+            node_t<_Tc, _DIM, _Td> * child = &((*(_children(node)))[idx]);
+            #pragma omp task if ((tail - head) > 16384)
+            _build(*child, head, tail);
+            head = tail;
+        }
+        assert(head == last);
+        #pragma omp taskwait
+    }
+
+
+/*
+    Return the leaf with room for coord (which is absent), splitting full leafs on the way (their nodes are pushed onto path)
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline node_t<_Tc, _DIM, _Td>& _room(node_t<_Tc, _DIM, _Td>& leaf, const std::array<_Tc, _DIM>& coord, node_t<_Tc, _DIM, _Td> ** path, size_t& depth)
+    {
+        node_t<_Tc, _DIM, _Td> * current = &leaf;
+        while (_data(*current)->size() == (1U << _DIM))
+        {
+            _split(*current);
+            current = &_leaf(*current, coord, path, depth);
+        }
+        return *current;
+    }
+
+
+/*
+    The default combine of insert, resize and merge_union: merge(left, right) of _Td
+*/
+struct merge_t
+    {
+        template<class _Td>
+        inline void operator()(_Td& left, const _Td& right) const { merge(left, right); }
+    };
+
+
+/*
+    Insert (coord, data) in the node, with combine(left = present, right = data) if coord is present
+    Descends in a loop, and only adds to the cached counts on the way once the item is known to be new
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tf>
+inline size_t _insert(node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coord, const _Td& data, const _Tf& combine)
+    {
+        std::array<node_t<_Tc, _DIM, _Td> *, 8U * sizeof(_Tc)> path;
+        size_t depth = 0U;
+        node_t<_Tc, _DIM, _Td>& leaf = _leaf(node, coord, &path[0], depth);
+        assert(_data(leaf));
+        for (auto& target : *(_data(leaf)))
+        {
+            if (_equal(target.first, coord))
+            {
+                combine(target.second, data);
+                return 0U;
+            }
+        }
+        _data(_room(leaf, coord, &path[0], depth))->push_back(std::make_pair(coord, data));
+        for (size_t level = 0U; level < depth; ++level)
+            ++(path[level]->_count);
+        return 1U;
+    }
+
+
+/*
+    Emplace (coord, args) in the node
+*/
+template<class _Tc, size_t _DIM, class _Td, class ... _Ts>
+inline size_t _emplace(node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coord, _Ts&& ... args)
+    {
+        std::array<node_t<_Tc, _DIM, _Td> *, 8U * sizeof(_Tc)> path;
+        size_t depth = 0U;
+        node_t<_Tc, _DIM, _Td>& leaf = _leaf(node, coord, &path[0], depth);
+        assert(_data(leaf));
+        for (auto& target : *(_data(leaf)))
+        {
+            if (_equal(target.first, coord))
+            {
+                merge(target.second, {args ...});
+                return 0U;
+            }
+        }
+        _data(_room(leaf, coord, &path[0], depth))->emplace_back(std::piecewise_construct, std::forward_as_tuple(coord), std::forward_as_tuple(args ...));
+        for (size_t level = 0U; level < depth; ++level)
+            ++(path[level]->_count);
+        return 1U;
+    }
+
+
+/*
+    Erase coord from the node
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline size_t _erase(node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coord)
+    {
+        std::array<node_t<_Tc, _DIM, _Td> *, 8U * sizeof(_Tc)> path;
+        size_t depth = 0U;
+        node_t<_Tc, _DIM, _Td>& leaf = _leaf(node, coord, &path[0], depth);
+        auto pos = _pair(leaf, coord);
+        if (pos == _data(leaf)->end())
+            return 0U;
+        _data(leaf)->erase(pos);
+        for (size_t level = 0U; level < depth; ++level)
+            --(path[level]->_count);
+        return 1U;
+    }
+
+
+/*
+    Subtract number (and their total weight) from the cached counts (and weight sums) of the depth nodes on the path from root,
+    which holds the indices of the children taken
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _discount(node_t<_Tc, _DIM, _Td>& root, const uint8_t * path, const uint8_t depth, const size_t number, const double weight)
+    {
+        node_t<_Tc, _DIM, _Td> * ancestor = &root;
+        for (uint8_t level = 0U; level < depth; ++level)
+        {
+            ancestor->_count -= number;
+            _children(*ancestor)->_sum -= weight;
+            ancestor = &((*(_children(*ancestor)))[path[level]]);
+        }
+    }
+
+
+/*
+    Combine pairs with identical coordinates
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tf>
+inline size_t _merge(data_vec<_Tc, _DIM, _Td>& data, const _Tf& combine)
+    {
+        size_t num_merged = 0U;
+        if (data.size() > 1U)
+        {
+            auto head = data.begin();
+            auto end  = data.end();
+            while (head != end)
+            {
+                auto& target = *head;
+                ++head;
+                auto iter   = head;
+                auto result = head;
                 while (iter != end)
                 {
-                    if (target.first == (*iter).first)
+                    if (_equal(target.first, (*iter).first))
                     {
-                        merge(target.second, (*iter).second);
+                        combine(target.second, (*iter).second);
                         ++num_merged;
                     }
                     else
@@ -299,141 +904,1066 @@ inline size_t _merge(data_vec<_Tc, _DIM, _Td>& data)
             }
             data.erase(end, data.end());
         }
-        return num_merged;
+        return num_merged;
+    }
+
+
+/*
+    Sort data in Morton order and merge the items with identical coordinates (stable: merged in the order of data)
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _sort_merge(data_vec<_Tc, _DIM, _Td>& data)
+    {
+        std::stable_sort(data.begin(), data.end(), [](const std::pair<std::array<_Tc, _DIM>, _Td>& left, const std::pair<std::array<_Tc, _DIM>, _Td>& right)
+            { return _morton_less(left.first, right.first); });
+        auto result = data.begin();
+        for (auto iter = data.begin(); iter != data.end(); ++iter)
+        {
+            if ((result != data.begin()) && _equal((*(result - 1)).first, (*iter).first))
+                merge((*(result - 1)).second, (*iter).second);
+            else
+            {
+                if (result != iter)
+                    *result = std::move(*iter);
+                ++result;
+            }
+        }
+        data.erase(result, data.end());
+    }
+
+
+/*
+    Resize the nodes recursively: coordinates are divided by two & colliding data is combined
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tf>
+inline size_t _resize(node_t<_Tc, _DIM, _Td>& node, const _Tf& combine)
+    {
+        size_t num_removed = 0U;
+        if (_data(node))
+        {
+            assert(!_children(node));
+            for (auto& item : *(_data(node)))
+                _shift(item.first);
+            num_removed = _merge(*(_data(node)), combine);
+        }
+        else
+        {
+            assert(_children(node));
+            if (node._level == 1U)
+            {
+                auto items = std::make_unique<data_vec<_Tc, _DIM, _Td>>();
+                for (auto& child : *(_children(node)))
+                {
+                    assert( _data(child));
+                    assert(!_children(child));
+                    if (_data(child)->size() != 0U)
+                    {
+                        num_removed += _data(child)->size() - 1U;
+                        auto& target = _data(child)->front();
+                        _shift(target.first);
+                        for (auto iter = ++(_data(child)->begin()); iter != _data(child)->end(); ++iter)
+                            combine(target.second, (*iter).second);
+                        items->push_back(std::move(target));
+                    }
+                }
+                _hold(node, std::move(items));
+            }
+            else
+            {
+                assert(node._level > 1U);
+                for (auto& child : *(_children(node)))
+                    num_removed += _resize(child, combine);
+                node._count -= num_removed;
+            }
+        }
+
+        assert(node._level != 0U);
+        node._level--;
+        return num_removed;
+    }
+
+
+/*
+    Hand the contents (data or children) of source over to the empty leaf node
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _adopt(node_t<_Tc, _DIM, _Td>& node, node_t<_Tc, _DIM, _Td>& source)
+    {
+        assert(_data(node));
+        assert(_data(node)->size() == 0U);
+        assert(node._level == source._level);
+        _hand_over(node, source);
+        node._count    = source._count;
+        _hold(source, std::make_unique<data_vec<_Tc, _DIM, _Td>>());
+    }
+
+
+/*
+    Merge the data of other into node with combine(left = node, right = other) (simultaneous walk over both trees; other is emptied)
+    Returns the number of coordinates which were added to node
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tf>
+inline size_t _union(node_t<_Tc, _DIM, _Td>& node, node_t<_Tc, _DIM, _Td>& other, const _Tf& combine)
+    {
+        assert(node._level == other._level);
+        size_t num_added = 0U;
+        if (_data(other))
+        {
+            for (const auto& item : *(_data(other)))
+                num_added += _insert(node, item.first, item.second, combine);
+            _data(other)->clear();
+        }
+        else if (_data(node))
+        {
+            // Move the subtree of other wholesale and reinsert the (at most 2^DIM) items of node
+            auto data = _release_data(node);
+            _hold(node, std::make_unique<data_vec<_Tc, _DIM, _Td>>());
+            _adopt(node, other);
+            num_added = _size(node);
+            for (auto& item : *data)
+            {
+                node_t<_Tc, _DIM, _Td>& leaf = _leaf(node, item.first);
+                auto pos = _pair(leaf, item.first);
+                if (pos == _data(leaf)->end())
+                    num_added += _insert(node, item.first, item.second, combine);
+                else
+                {
+                    combine(item.second, (*pos).second); // Keep combine(left = node, right = other)
+                    (*pos).second = std::move(item.second);
+                }
+            }
+            num_added -= data->size();
+        }
+        else
+        {
+            for (size_t idx = 0U; idx < (1U << _DIM); ++idx)
+                num_added += _union((*(_children(node)))[idx], (*(_children(other)))[idx], combine);
+            node._count += num_added;
+            other._count = 0U;
+        }
+        return num_added;
+    }
+
+
+/*
+    Keep only the coordinates of node which are present in other, and combine(left = node, right = other) their data
+    Returns the number of coordinates which were removed from node
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tf>
+inline size_t _intersect(node_t<_Tc, _DIM, _Td>& node, node_t<_Tc, _DIM, _Td>& other, _Tf& combine)
+    {
+        assert(node._level == other._level);
+        size_t num_removed = 0U;
+        if (_data(node))
+        {
+            auto result = _data(node)->begin();
+            for (auto& item : *(_data(node)))
+            {
+                const node_t<_Tc, _DIM, _Td>& leaf = _leaf(other, item.first);
+                auto pos = _pair(leaf, item.first);
+                if (pos != _data(leaf)->end())
+                {
+                    combine(item.second, (*pos).second);
+                    if (&(*result) != &item)
+                        *result = std::move(item);
+                    ++result;
+                }
+            }
+            num_removed = _data(node)->end() - result;
+            _data(node)->erase(result, _data(node)->end());
+        }
+        else if (_data(other))
+        {
+            // At most 2^DIM survivors: node collapses into a leaf
+            auto data = std::make_unique<data_vec<_Tc, _DIM, _Td>>();
+            for (const auto& item : *(_data(other)))
+            {
+                const node_t<_Tc, _DIM, _Td>& leaf = _leaf(node, item.first);
+                auto pos = _pair(leaf, item.first);
+                if (pos != _data(leaf)->end())
+                {
+                    combine((*pos).second, item.second);
+                    data->push_back(std::move(*pos));
+                }
+            }
+            num_removed = _size(node) - data->size();
+            _hold(node, std::move(data));
+        }
+        else
+        {
+            for (size_t idx = 0U; idx < (1U << _DIM); ++idx)
+                num_removed += _intersect((*(_children(node)))[idx], (*(_children(other)))[idx], combine);
+            node._count -= num_removed;
+        }
+        return num_removed;
+    }
+
+
+/*
+    Remove the coordinates of node which are present in other
+    Returns the number of coordinates which were removed from node
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline size_t _difference(node_t<_Tc, _DIM, _Td>& node, node_t<_Tc, _DIM, _Td>& other)
+    {
+        assert(node._level == other._level);
+        size_t num_removed = 0U;
+        if (_data(other))
+        {
+            for (const auto& item : *(_data(other)))
+                num_removed += _erase(node, item.first);
+        }
+        else if (_data(node))
+        {
+            auto result = _data(node)->begin();
+            for (auto& item : *(_data(node)))
+            {
+                const node_t<_Tc, _DIM, _Td>& leaf = _leaf(other, item.first);
+                if (_pair(leaf, item.first) == _data(leaf)->end())
+                {
+                    if (&(*result) != &item)
+                        *result = std::move(item);
+                    ++result;
+                }
+            }
+            num_removed = _data(node)->end() - result;
+            _data(node)->erase(result, _data(node)->end());
+        }
+        else
+        {
+            for (size_t idx = 0U; idx < (1U << _DIM); ++idx)
+                num_removed += _difference((*(_children(node)))[idx], (*(_children(other)))[idx]);
+            node._count -= num_removed;
+        }
+        return num_removed;
+    }
+
+
+/*
+    Call f(item) for the data items of a node and its children
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tf>
+inline void _for_each(const node_t<_Tc, _DIM, _Td>& node, _Tf& f)
+    {
+        if (!_children(node))
+        {
+            _touch(node);
+            for (const auto& item : *(_data(node)))
+                f(item);
+        }
+        else
+        {
+            for (const auto& child : *(_children(node)))
+                _for_each(child, f);
+        }
+    }
+
+
+/*
+    Report the coordinates which were added, removed or changed when going from node to other
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Ta, class _Tr, class _Tm, class _Te>
+inline void _diff(node_t<_Tc, _DIM, _Td>& node, node_t<_Tc, _DIM, _Td>& other, _Ta& on_added, _Tr& on_removed, _Tm& on_changed, _Te& equal)
+    {
+        assert(node._level == other._level);
+        if ((_size(node) == 0U) && (_size(other) == 0U))
+            return;
+        if (_children(node) && _children(other))
+        {
+            for (size_t idx = 0U; idx < (1U << _DIM); ++idx)
+                _diff((*(_children(node)))[idx], (*(_children(other)))[idx], on_added, on_removed, on_changed, equal);
+        }
+        else
+        {
+            auto added = [&](const std::pair<std::array<_Tc, _DIM>, _Td>& item)
+            {
+                const node_t<_Tc, _DIM, _Td>& leaf = _leaf(node, item.first);
+                auto pos = _pair(leaf, item.first);
+                if (pos == _data(leaf)->end())
+                    on_added(item);
+                else if (!equal((*pos).second, item.second))
+                    on_changed(*pos, item);
+            };
+            auto removed = [&](const std::pair<std::array<_Tc, _DIM>, _Td>& item)
+            {
+                const node_t<_Tc, _DIM, _Td>& leaf = _leaf(other, item.first);
+                if (_pair(leaf, item.first) == _data(leaf)->end())
+                    on_removed(item);
+            };
+            _for_each(other, added);
+            _for_each(node, removed);
+        }
+    }
+
+
+/*
+    Check whether node and other hold the same coordinates and data (short-circuits on the cached counts)
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Te>
+inline bool _equal(node_t<_Tc, _DIM, _Td>& node, node_t<_Tc, _DIM, _Td>& other, _Te& equal)
+    {
+        assert(node._level == other._level);
+        if (_size(node) != _size(other))
+            return false;
+        if (_children(node) && _children(other))
+        {
+            for (size_t idx = 0U; idx < (1U << _DIM); ++idx)
+            {
+                if (!_equal((*(_children(node)))[idx], (*(_children(other)))[idx], equal))
+                    return false;
+            }
+            return true;
+        }
+        // Equal counts: it suffices to look up the items of the leaf side (at most 2^DIM) in the other side
+        if (!_children(node))
+            _touch(node);
+        if (!_children(other))
+            _touch(other);
+        const bool leaf_left = (_data(node) != nullptr);
+        const data_vec<_Tc, _DIM, _Td>& items = leaf_left ? *(_data(node)) : *(_data(other));
+        for (const auto& item : items)
+        {
+            const node_t<_Tc, _DIM, _Td>& leaf = _leaf(leaf_left ? other : node, item.first);
+            auto pos = _pair(leaf, item.first);
+            if (pos == _data(leaf)->end())
+                return false;
+            if (!(leaf_left ? equal(item.second, (*pos).second) : equal((*pos).second, item.second)))
+                return false;
+        }
+        return true;
+    }
+
+
+/*
+    Bound on key(data) in the leafs of a node, recomputed from the children where it is unknown (NaN)
+    The recomputed bounds are stored if store, so that const queries only read the tree
+*/
+template<bool store, class _Tc, size_t _DIM, class _Td, class _Tk>
+inline double _peak(const node_t<_Tc, _DIM, _Td>& node, const _Tk& key)
+    {
+        double result = -std::numeric_limits<double>::infinity();
+        if (!_children(node))
+        {
+            _touch(node);
+            for (const auto& item : *(_data(node)))
+                result = std::max(result, key(item.second));
+            return result;
+        }
+        if (!std::isnan(_children(node)->_max))
+            return _children(node)->_max;
+        for (const auto& child : *(_children(node)))
+            result = std::max(result, _peak<store>(child, key));
+        if (store)
+            _children(node)->_max = result;
+        return result;
+    }
+
+
+/*
+    Recompute the bounds on key(data) of a node and its children
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tk>
+inline double _bound(node_t<_Tc, _DIM, _Td>& node, const _Tk& key)
+    {
+        double result = -std::numeric_limits<double>::infinity();
+        if (_data(node))
+        {
+            for (const auto& item : *(_data(node)))
+                result = std::max(result, key(item.second));
+        }
+        else
+        {
+            for (auto& child : *(_children(node)))
+                result = std::max(result, _bound(child, key));
+            _children(node)->_max = result;
+        }
+        return result;
+    }
+
+
+/*
+    Raise the bounds on the path to coord (which is present) to key(data of coord); returns the latter
+    Nodes which were split on the way, or whose data was handed out for writing, have an unknown bound, which is recomputed from their children
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tk>
+inline double _raise(node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coord, const _Tk& key)
+    {
+        if (_data(node))
+        {
+            auto pos = _pair(node, coord);
+            assert(pos != _data(node)->end());
+            return key((*pos).second);
+        }
+        const double value = _raise(_child(node, coord), coord, key);
+        double& bound = _children(node)->_max;
+        bound = std::isnan(bound) ? _peak<true>(node, key) : std::max(bound, value);
+        return value;
+    }
+
+
+/*
+    Sum of weight(data) in the leafs of a node, recomputed from the children where it is unknown (NaN)
+    The recomputed sums are stored if store, so that const queries only read the tree
+*/
+template<bool store, class _Tc, size_t _DIM, class _Td, class _Tw>
+inline double _weigh(const node_t<_Tc, _DIM, _Td>& node, const _Tw& weight)
+    {
+        double result = 0.0;
+        if (!_children(node))
+        {
+            _touch(node);
+            for (const auto& item : *(_data(node)))
+                result += weight(item.second);
+            return result;
+        }
+        if (!std::isnan(_children(node)->_sum))
+            return _children(node)->_sum;
+        for (const auto& child : *(_children(node)))
+            result += _weigh<store>(child, weight);
+        if (store)
+            _children(node)->_sum = result;
+        return result;
+    }
+
+
+/*
+    Recompute the sums of weight(data) of a node and its children
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tw>
+inline double _total(node_t<_Tc, _DIM, _Td>& node, const _Tw& weight)
+    {
+        double result = 0.0;
+        if (_data(node))
+        {
+            for (const auto& item : *(_data(node)))
+                result += weight(item.second);
+        }
+        else
+        {
+            for (auto& child : *(_children(node)))
+                result += _total(child, weight);
+            _children(node)->_sum = result;
+        }
+        return result;
+    }
+
+
+/*
+    Update the sums on the path to coord (which is present), whose weight(data) changed from before; returns the new weight
+    Nodes which were split on the way, or whose data was handed out for writing, have an unknown sum, which is recomputed from their children
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tw>
+inline double _reweigh(node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coord, const _Tw& weight, const double before)
+    {
+        if (_data(node))
+        {
+            auto pos = _pair(node, coord);
+            assert(pos != _data(node)->end());
+            return weight((*pos).second);
+        }
+        const double after = _reweigh(_child(node, coord), coord, weight, before);
+        double& sum = _children(node)->_sum;
+        if (std::isnan(sum))
+            _weigh<true>(node, weight);
+        else
+            sum += after - before;
+        return after;
+    }
+
+
+/*
+    Forget the bounds and sums on the path to coord, whose data is handed out for writing
+    Every ancestor of a node with an unknown bound (sum) has an unknown bound (sum), so a known one holds for the whole subtree
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _forget(const node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coord)
+    {
+        for (const node_t<_Tc, _DIM, _Td> * iter = &node; _children(*iter); iter = &_child(*iter, coord))
+        {
+            _children(*iter)->_max = std::numeric_limits<double>::quiet_NaN();
+            _children(*iter)->_sum = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+
+
+/*
+    Subtract weight from the sums on the path to coord
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _subtract(node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coord, const double weight)
+    {
+        for (node_t<_Tc, _DIM, _Td> * iter = &node; _children(*iter); iter = &_child(*iter, coord))
+            _children(*iter)->_sum -= weight;
+    }
+
+
+/*
+    Select the data items of a node and its children at the sorted positions [first, last) of the cumulative measure
+    measure.node(child) gives the total measure of a child, and measure.item(data) the measure of a data item
+    Positions beyond the total (rounding) fall to the last item with a positive measure
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tp, class _Tm>
+inline void _select(const node_t<_Tc, _DIM, _Td>& node, _Tp first, _Tp last, double offset, const _Tm& measure,
+                    std::vector<std::pair<const node_t<_Tc, _DIM, _Td> *, typename data_vec<_Tc, _DIM, _Td>::iterator>>& result)
+    {
+        if (first == last)
+            return;
+        if (!_children(node))
+        {
+            _touch(node);
+            auto chosen = _data(node)->end();
+            for (auto item = _data(node)->begin(); (item != _data(node)->end()) && (first != last); ++item)
+            {
+                const double value = measure.item((*item).second);
+                if (value <= 0.0)
+                    continue;
+                offset += value;
+                chosen = item;
+                for (; (first != last) && (*first < offset); ++first)
+                    result.push_back({ &node, item });
+            }
+            assert((first == last) || (chosen != _data(node)->end()));
+            for (; first != last; ++first)
+                result.push_back({ &node, chosen });
+            return;
+        }
+        std::array<double, (1U << _DIM)> values;
+        size_t final = 0U;
+        for (size_t idx = 0U; idx < (1U << _DIM); ++idx)
+        {
+            values[idx] = measure.node((*(_children(node)))[idx]);
+            if (values[idx] > 0.0)
+                final = idx;
+        }
+        for (size_t idx = 0U; idx <= final; ++idx)
+        {
+            offset += values[idx];
+            _Tp tail = (idx == final) ? last : std::partition_point(first, last, [&](const double position){ return position < offset; });
+            _select((*(_children(node)))[idx], first, tail, offset - values[idx], measure, result);
+            first = tail;
+        }
+    }
+
+
+/*
+    Collect the (at most k) data items of a node and its children with the largest key(data), in descending order
+    Best-first search: subtrees are expanded in order of their bounds until k items are found
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tk>
+inline void _top_k(const node_t<_Tc, _DIM, _Td>& root, const size_t k, const _Tk& key,
+                   std::vector<std::pair<const node_t<_Tc, _DIM, _Td> *, typename data_vec<_Tc, _DIM, _Td>::iterator>>& result)
+    {
+        struct candidate
+        {
+            double                                       bound;
+            const node_t<_Tc, _DIM, _Td> *              node;
+            typename data_vec<_Tc, _DIM, _Td>::iterator item; // end() of the data of node for subtrees
+            bool operator<(const candidate& other) const { return bound < other.bound; }
+        };
+        std::priority_queue<candidate> queue;
+        auto expand = [&](const node_t<_Tc, _DIM, _Td>& node)
+        {
+            if (!_children(node))
+            {
+                _touch(node);
+                for (auto item = _data(node)->begin(); item != _data(node)->end(); ++item)
+                    queue.push({ key((*item).second), &node, item });
+            }
+            else if (node._count != 0U)
+                queue.push({ _peak<false>(node, key), &node, typename data_vec<_Tc, _DIM, _Td>::iterator() });
+        };
+
+        expand(root);
+        while ((result.size() < k) && !queue.empty())
+        {
+            const candidate top = queue.top();
+            queue.pop();
+            if (_data(*top.node))
+                result.push_back({ top.node, top.item });
+            else
+            {
+                for (const auto& child : *(_children(*top.node)))
+                    expand(child);
+            }
+        }
+    }
+
+
+/*
+    Call f(item) for the data items of a node and its children with coordinate dim equal to value
+    Only the children with the matching bit of dim are visited
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tf>
+inline void _slice(const node_t<_Tc, _DIM, _Td>& node, const size_t dim, const _Tc value, _Tf& f)
+    {
+        if (!_children(node))
+        {
+            _touch(node);
+            for (const auto& item : *(_data(node)))
+            {
+                if (item.first[dim] == value)
+                    f(item);
+            }
+        }
+        else
+        {
+            const uint32_t mask = 1U << (_DIM - 1U - dim);
+            const uint32_t bit  = ((value >> node._level) & 1U) ? mask : 0U;
+            for (uint32_t idx = 0U; idx < (1U << _DIM); ++idx)
+            {
+                if ((idx & mask) == bit)
+                    _slice((*(_children(node)))[idx], dim, value, f);
+            }
+        }
+    }
+
+
+/*
+    hilbert_t<_DIM>: state of Skilling's transform (as in hilbert.hpp) for the bits below a level
+        * _axes[i] is the coordinate whose lower bits end up in X[i]
+        * bit i of _flips indicates whether the lower bits of X[i] are inverted
+        * _parity is the correction of the higher bits after Gray encoding
+*/
+template<size_t _DIM>
+struct hilbert_t
+    {
+        std::array<uint8_t, _DIM> _axes;
+        uint32_t                  _flips;
+        uint32_t                  _parity;
+    };
+
+
+/*
+    Return the Hilbert digit of the bits (as in _bits) at the level of state, and advance state to the next level
+*/
+template<size_t _DIM>
+inline uint32_t _hilbert_step(hilbert_t<_DIM>& state, const uint32_t bits) noexcept
+    {
+        uint32_t x = 0U;
+        for (size_t idx = 0U; idx < _DIM; ++idx)
+            x |= (((bits >> (_DIM - 1U - state._axes[idx])) ^ (state._flips >> idx)) & 1U) << idx;
+        for (size_t idx = 0U; idx < _DIM; ++idx)
+        {
+            if ((x >> idx) & 1U)
+                state._flips ^= 1U;
+            else if (idx != 0U)
+            {
+                std::swap(state._axes[0], state._axes[idx]);
+                const uint32_t swap = (state._flips ^ (state._flips >> idx)) & 1U;
+                state._flips ^= swap | (swap << idx);
+            }
+        }
+        uint32_t digit = 0U;
+        uint32_t gray  = 0U;
+        for (size_t idx = 0U; idx < _DIM; ++idx)
+        {
+            gray  ^= (x >> idx) & 1U;
+            digit |= (gray ^ state._parity) << (_DIM - 1U - idx);
+        }
+        state._parity ^= gray;
+        return digit;
+    }
+
+
+/*
+    Call f(item) for the data items of a node and its children in Hilbert order
+    The children are visited in the order of their Hilbert digits, and the items of a leaf are sorted by descending the remaining levels
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tf>
+inline void _hilbert(const node_t<_Tc, _DIM, _Td>& node, const hilbert_t<_DIM>& state, _Tf& f)
+    {
+        if (!_children(node))
+        {
+            _touch(node);
+            std::vector<const std::pair<std::array<_Tc, _DIM>, _Td> *> items;
+            items.reserve(_data(node)->size());
+            for (const auto& item : *(_data(node)))
+                items.push_back(&item);
+            std::sort(items.begin(), items.end(), [&](const std::pair<std::array<_Tc, _DIM>, _Td> * left, const std::pair<std::array<_Tc, _DIM>, _Td> * right)
+            {
+                hilbert_t<_DIM> current = state;
+                for (uint8_t level = node._level; ; --level)
+                {
+                    const uint32_t bits_left  = _bits(left->first,  level);
+                    const uint32_t bits_right = _bits(right->first, level);
+                    if (bits_left != bits_right)
+                    {
+                        hilbert_t<_DIM> other = current;
+                        return _hilbert_step(current, bits_left) < _hilbert_step(other, bits_right);
+                    }
+                    if (level == 0U)
+                        return false;
+                    _hilbert_step(current, bits_left);
+                }
+            });
+            for (const auto * item : items)
+                f(*item);
+        }
+        else
+        {
+            std::array<hilbert_t<_DIM>, (1U << _DIM)> states;
+            std::array<uint32_t, (1U << _DIM)> order;
+            for (uint32_t idx = 0U; idx < (1U << _DIM); ++idx)
+            {
+                states[idx] = state;
+                order[_hilbert_step(states[idx], idx)] = idx;
+            }
+            for (const uint32_t idx : order)
+                _hilbert((*(_children(node)))[idx], states[idx], f);
+        }
+    }
+
+
+/*
+    Number of neighbours of a cell: 3^DIM - 1
+*/
+inline constexpr size_t _num_neighbours(const size_t DIM) noexcept
+    {
+        return (DIM == 0U) ? 0U : 3U * (_num_neighbours(DIM - 1U) + 1U) - 1U;
+    }
+
+
+/*
+    Check whether node covers all coordinates which differ from its own only in the bits of mask
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline bool _covers(const node_t<_Tc, _DIM, _Td>& node, const _Tc mask) noexcept
+    {
+        return (node._level + 1U >= 8U * sizeof(_Tc)) || ((mask >> (node._level + 1U)) == 0U);
+    }
+
+
+/*
+    Return the leaf holding target, starting from the lowest common ancestor on the path to coord
+    The path holds the nodes from the root (depth 0) down to the leaf of coord (depth)
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline const node_t<_Tc, _DIM, _Td> * _lca_leaf(node_t<_Tc, _DIM, _Td> * const * path, size_t depth, const std::array<_Tc, _DIM>& coord, const std::array<_Tc, _DIM>& target)
+    {
+        _Tc mask = 0U;
+        for (size_t idx = 0U; idx < _DIM; ++idx)
+            mask |= coord[idx] ^ target[idx];
+        while (!_covers(*(path[depth]), mask))
+        {
+            if (depth == 0U)
+                return nullptr; // Outside of the range of the (resized) coordinates
+            --depth;
+        }
+        return &_leaf(*(path[depth]), target);
+    }
+
+
+/*
+    Set target = coord + offset(k), with the offsets in {-1, 0, 1}^DIM enumerated as base-3 numbers
+    (first coordinate most significant) without the all-zero offset
+    Returns false if target falls outside of the range of _Tc
+*/
+template<class _Tc, size_t _DIM>
+inline bool _offset(const std::array<_Tc, _DIM>& coord, const size_t k, std::array<_Tc, _DIM>& target) noexcept
+    {
+        target = coord;
+        bool valid = true;
+        size_t digits = (k < _num_neighbours(_DIM) / 2U) ? k : k + 1U; // Skip the all-zero offset
+        for (size_t idx = _DIM; idx-- > 0U;)
+        {
+            const size_t digit = digits % 3U;
+            digits /= 3U;
+            if (digit == 0U)
+            {
+                valid = valid && (target[idx] != 0U);
+                --target[idx];
+            }
+            else if (digit == 2U)
+            {
+                ++target[idx];
+                valid = valid && (target[idx] != 0U);
+            }
+        }
+        return valid;
+    }
+
+
+/*
+    Call f(item, neighbours) for the data items of a node and its children
+    neighbours[k] points to the item at coord + offset(k), or is nullptr
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tf>
+inline void _stencil(node_t<_Tc, _DIM, _Td>& node, node_t<_Tc, _DIM, _Td> ** path, const size_t depth,
+                     std::array<const std::pair<std::array<_Tc, _DIM>, _Td> *, _num_neighbours(_DIM)>& neighbours, _Tf& f)
+    {
+        path[depth] = &node;
+        if (_children(node))
+        {
+            for (auto& child : *(_children(node)))
+                _stencil(child, path, depth + 1U, neighbours, f);
+            return;
+        }
+        _touch(node);
+        for (const auto& item : *(_data(node)))
+        {
+            for (size_t k = 0U; k < _num_neighbours(_DIM); ++k)
+            {
+                std::array<_Tc, _DIM> target;
+                neighbours[k] = nullptr;
+                if (_offset(item.first, k, target))
+                {
+                    const node_t<_Tc, _DIM, _Td> * leaf = _lca_leaf(path, depth, item.first, target);
+                    if (leaf)
+                    {
+                        auto pos = _pair(*leaf, target);
+                        if (pos != _data(*leaf)->end())
+                            neighbours[k] = &(*pos);
+                    }
+                }
+            }
+            f(item, neighbours);
+        }
+    }
+
+
+/*
+    Store the iteration index of the first data item of each leaf
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _bases(const node_t<_Tc, _DIM, _Td>& node, std::unordered_map<const node_t<_Tc, _DIM, _Td> *, size_t>& bases, size_t& index)
+    {
+        if (_children(node))
+        {
+            for (const auto& child : *(_children(node)))
+                _bases(child, bases, index);
+        }
+        else if (_size(node) != 0U)
+        {
+            bases[&node] = index;
+            index += _size(node);
+        }
+    }
+
+
+/*
+    Union-find: representative of the set of element (with path halving)
+*/
+inline size_t _find_set(std::vector<size_t>& parents, size_t element) noexcept
+    {
+        while (parents[element] != element)
+        {
+            parents[element] = parents[parents[element]];
+            element = parents[element];
+        }
+        return element;
     }
 
 
 /*
-    Resize the nodes recursively: coordinates are divided by two & colliding data is merged
+    Join the sets of the data items of a node and its children with those of their neighbours offset(k) for k in codes
 */
 template<class _Tc, size_t _DIM, class _Td>
-inline size_t _resize(node_t<_Tc, _DIM, _Td>& node)
+inline void _join(node_t<_Tc, _DIM, _Td>& node, node_t<_Tc, _DIM, _Td> ** path, const size_t depth, const std::vector<size_t>& codes,
+                  const std::unordered_map<const node_t<_Tc, _DIM, _Td> *, size_t>& bases, std::vector<size_t>& parents, size_t& index)
     {
-        size_t num_removed = 0U;
-        if (node._data)
+        path[depth] = &node;
+        if (_children(node))
         {
-            assert(!node._children);
-            for (auto& item : *(node._data))
-                _shift(item.first);
-            num_removed = _merge(*(node._data));
+            for (auto& child : *(_children(node)))
+                _join(child, path, depth + 1U, codes, bases, parents, index);
+            return;
         }
-        else
+        _touch(node);
+        for (const auto& item : *(_data(node)))
         {
-            assert(node._children);
-            if (node._level == 1U)
-            {
-                node._data = std::make_unique<data_vec<_Tc, _DIM, _Td>>();
-                for (auto& child : *(node._children))
-                {
-                    assert( child._data);
-                    assert(!child._children);
-                    if (child._data->size() != 0U)
-                    {
-                        num_removed += child._data->size() - 1U;
-                        auto& target = child._data->front();
-                        _shift(target.first);
-                        for (auto iter = ++(child._data->begin()); iter != child._data->end(); ++iter)
-                            merge(target.second, (*iter).second);
-                        node._data->push_back(std::move(target));
-                    }
-                }
-                node._children.reset(nullptr);
-            }
-            else
+            for (const size_t k : codes)
             {
-                assert(node._level > 1U);
-                for (auto& child : *(node._children))
-                    num_removed += _resize(child);
+                std::array<_Tc, _DIM> target;
+                if (!_offset(item.first, k, target))
+                    continue;
+                const node_t<_Tc, _DIM, _Td> * leaf = _lca_leaf(path, depth, item.first, target);
+                if (leaf == nullptr)
+                    continue;
+                auto pos = _pair(*leaf, target);
+                if (pos == _data(*leaf)->end())
+                    continue;
+                const size_t set1 = _find_set(parents, index);
+                const size_t set2 = _find_set(parents, bases.at(leaf) + (pos - _data(*leaf)->begin()));
+                parents[std::max(set1, set2)] = std::min(set1, set2);
             }
+            ++index;
         }
-
-        assert(node._level != 0U);
-        node._level--;
-        return num_removed;
     }
 
 
-template<typename _It, class _Ta>
-inline typename std::enable_if<std::is_same<_It, typename _Ta::const_iterator>::value, _It>::type _begin(_Ta& in)
-{
-    return in.cbegin();
-}
+/*
+    Child index at rank in the order of iteration (an involution, so it also returns the rank of a child index)
+*/
+template<bool _forward, size_t _DIM>
+inline constexpr uint32_t _order(const uint32_t rank) noexcept
+    {
+        return _forward ? rank : (1U << _DIM) - 1U - rank;
+    }
+
 
-template<typename _It, class _Ta>
-inline typename std::enable_if<std::is_same<_It, typename _Ta::const_reverse_iterator>::value, _It>::type _begin(_Ta& in)
-{
-    return in.crbegin();
-}
+/*
+    Search data down the tree, and push the indices of the children taken onto path (which holds depth indices)
+*/
+template<bool _forward, class _Tc, size_t _DIM, class _Td>
+inline const node_t<_Tc, _DIM, _Td> * _down(const node_t<_Tc, _DIM, _Td>& node, uint8_t * path, uint8_t& depth)
+    {
+        const node_t<_Tc, _DIM, _Td> * current = &node;
+        while (_children(*current))
+        {
+            const node_arr<_Tc, _DIM, _Td>& children = *(_children(*current));
+            uint32_t rank = 0U;
+            while ((rank < (1U << _DIM)) && !_children(children[_order<_forward, _DIM>(rank)]) && (_size(children[_order<_forward, _DIM>(rank)]) == 0U))
+                ++rank;
+            assert(rank < (1U << _DIM));
+            path[depth++] = static_cast<uint8_t>(_order<_forward, _DIM>(rank));
+            current = &(children[_order<_forward, _DIM>(rank)]);
+        }
+        assert(_size(*current) != 0U);
+        _touch(*current);
+        return current;
+    }
 
-template<typename _It, class _Ta>
-inline typename std::enable_if<std::is_same<_It, typename _Ta::const_iterator>::value, _It>::type _end(_Ta& in)
-{
-    return in.cend();
-}
 
-template<typename _It, class _Ta>
-inline typename std::enable_if<std::is_same<_It, typename _Ta::const_reverse_iterator>::value, _It>::type _end(_Ta& in)
-{
-    return in.crend();
-}
+/*
+    Return the node at depth on the path from root, which holds the indices of the children taken
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline const node_t<_Tc, _DIM, _Td> * _ancestor(const node_t<_Tc, _DIM, _Td>& root, const uint8_t * path, const uint8_t depth) noexcept
+    {
+        const node_t<_Tc, _DIM, _Td> * current = &root;
+        for (uint8_t level = 0U; level < depth; ++level)
+            current = &((*(_children(*current)))[path[level]]);
+        return current;
+    }
 
 
 /*
-    Search data down the tree
+    Search the next node with data after the leaf node, whose path from root holds depth child indices (popped and pushed along the way)
+    The siblings of a node follow from its address and index, so no siblings are scanned and no nodes are kept;
+    only when all siblings are done, the parent is found again from root
 */
-template<typename _It, class _Tc, size_t _DIM, class _Td>
-inline const node_t<_Tc, _DIM, _Td> * _down(const node_t<_Tc, _DIM, _Td>& node) noexcept
+template<bool _forward, class _Tc, size_t _DIM, class _Td>
+inline const node_t<_Tc, _DIM, _Td> * _next(const node_t<_Tc, _DIM, _Td>& node, const node_t<_Tc, _DIM, _Td>& root, uint8_t * path, uint8_t& depth)
     {
-        if (node._children)
+        for (const node_t<_Tc, _DIM, _Td> * current = &node; depth != 0U; current = _ancestor(root, path, --depth))
         {
-            _It child = _begin<_It>(*(node._children));
-            _It   end =   _end<_It>(*(node._children));
-            for (; child != end; ++child)
+            const node_t<_Tc, _DIM, _Td> * siblings = current - path[depth - 1U];
+            for (uint32_t rank = _order<_forward, _DIM>(path[depth - 1U]) + 1U; rank < (1U << _DIM); ++rank)
             {
-                if (child->_children)
-                    return _down<_It>(*child);
-                else
+                const node_t<_Tc, _DIM, _Td>& sibling = siblings[_order<_forward, _DIM>(rank)];
+                if (_children(sibling) || (_size(sibling) != 0U))
                 {
-                    if (child->_data->size() != 0U)
-                        return &(*child);
+                    path[depth - 1U] = static_cast<uint8_t>(_order<_forward, _DIM>(rank));
+                    return _down<_forward>(sibling, path, depth);
                 }
             }
         }
-        else
-        {
-            if (node._data->size() != 0U)
-                return &node;
-        }
-        assert(false);
         return nullptr;
     }
 
 
 /*
-    Search the next node with data
+    Return the leaf to which coordinates correspond, and push the indices of the children taken onto path (which holds depth indices)
 */
-template<typename _It, class _Tc, size_t _DIM, class _Td>
-inline const node_t<_Tc, _DIM, _Td> * _next(const node_t<_Tc, _DIM, _Td>& node) noexcept
+template<class _Tc, size_t _DIM, class _Td>
+inline const node_t<_Tc, _DIM, _Td> * _descend(const node_t<_Tc, _DIM, _Td>& node, const std::array<_Tc, _DIM>& coordinates, uint8_t * path, uint8_t& depth)
     {
-        if (node._parent == nullptr)
-            return nullptr;
+        const node_t<_Tc, _DIM, _Td> * current = &node;
+        for (; _children(*current); current = &_child(*current, coordinates))
+            path[depth++] = static_cast<uint8_t>(_index(*current, coordinates));
+        _touch(*current);
+        return current;
+    }
 
-        _It iter = _begin<_It>(*(node._parent->_children));
-        _It  end =   _end<_It>(*(node._parent->_children));
-        while (&(*iter) != &node)
-            ++iter;
 
-        for (++iter; iter != end; ++iter)
+/*
+    filter_t<_Tc, _DIM>: blocked Bloom filter on the coordinates
+        * every coordinate sets _probes bits in one block of 512 bits (one cache line)
+        * _capacity is the number of entries the blocks were sized for
+        * _stale counts the entries erased since the last rebuild (their bits remain set)
+*/
+template<class _Tc, size_t _DIM>
+struct filter_t
+    {
+        std::vector<std::array<uint64_t, 8U>> _blocks;
+        size_t                                _bits;
+        size_t                                _probes;
+        size_t                                _capacity;
+        size_t                                _stale;
+    };
+
+
+/*
+    Mix the coordinates into 64 bits
+*/
+template<class _Tc, size_t _DIM>
+inline uint64_t _hash(const std::array<_Tc, _DIM>& coordinates) noexcept
+    {
+        uint64_t result = 0x9e3779b97f4a7c15ULL;
+        for (const _Tc coord : coordinates)
         {
-            if (iter->_children)
-                return _down<_It>(*iter);
-            else
+            for (size_t shift = 0U; shift < 8U * sizeof(_Tc); shift += 64U)
             {
-                if (iter->_data->size() != 0U)
-                    return &(*iter);
+                result ^= static_cast<uint64_t>(coord >> shift);
+                result *= 0xbf58476d1ce4e5b9ULL;
+                result ^= result >> 31U;
             }
         }
-        return _next<_It>(*(node._parent));
+        result *= 0x94d049bb133111ebULL;
+        return result ^ (result >> 29U);
+    }
+
+
+/*
+    Clear the filter and size its blocks for capacity entries
+*/
+template<class _Tc, size_t _DIM>
+inline void _reset(filter_t<_Tc, _DIM>& filter, const size_t capacity)
+    {
+        filter._capacity = capacity;
+        filter._stale    = 0U;
+        filter._blocks.assign((capacity * filter._bits + 511U) / 512U + 1U, std::array<uint64_t, 8U>{});
+    }
+
+
+/*
+    Set (if mark) or test the bits of coordinates: the upper 32 bits of the hash select the block, the bits of a second mix select 9 bits per probe
+*/
+template<class _Tc, size_t _DIM, bool mark>
+inline bool _probe(filter_t<_Tc, _DIM>& filter, const std::array<_Tc, _DIM>& coordinates) noexcept
+    {
+        const uint64_t hash = _hash(coordinates);
+        std::array<uint64_t, 8U>& block = filter._blocks[((hash >> 32U) * filter._blocks.size()) >> 32U];
+        uint64_t bits = hash * 0xff51afd7ed558ccdULL;
+        bits ^= bits >> 33U;
+        for (size_t probe = 0U; probe < filter._probes; ++probe, bits >>= 9U)
+        {
+            const uint64_t mask = 1ULL << (bits & 63U);
+            if (mark)
+                block[(bits >> 6U) & 7U] |= mask;
+            else if ((block[(bits >> 6U) & 7U] & mask) == 0U)
+                return false;
+        }
+        return true;
+    }
+
+
+/*
+    Rebuild the filter for the data items of a node and its children
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline void _fill(filter_t<_Tc, _DIM>& filter, const node_t<_Tc, _DIM, _Td>& node)
+    {
+        if (_data(node))
+        {
+            for (const auto& item : *(_data(node)))
+                _probe<_Tc, _DIM, true>(filter, item.first);
+        }
+        else
+        {
+            for (const auto& child : *(_children(node)))
+                _fill(filter, child);
+        }
     }
 
 
@@ -458,23 +1988,182 @@ class cmap {
         uint8_t _num_resizes;
         size_t  _size;
         std::unique_ptr<node_t> _root;
+        std::function<double(const _Td&)> _key;
+        std::function<double(const _Td&)> _weight;
+        std::unique_ptr<_cmapbase::filter_t<_Tc, _DIM>> _filter;
+        mutable bool _frozen;
+
+        // Decompress all cold leafs, before operations which restructure (nearly) all leafs
+        inline void _thaw_all() const
+        {
+            if (_frozen)
+            {
+                _cmapbase::_thaw(*_root);
+                _frozen = false;
+            }
+        }
+
+        // Rebuild the filter with room to double
+        inline void _refilter()
+        {
+            _thaw_all();
+            _cmapbase::_reset(*_filter, 2U * std::max(_size, static_cast<size_t>(32U)));
+            _cmapbase::_fill(*_filter, *_root);
+        }
+
+        // Account for number erased entries in the filter
+        inline void _unfilter(const size_t number)
+        {
+            if (_filter && ((_filter->_stale += number) > _filter->_capacity / 2U))
+                _refilter();
+        }
+
+        // Definite misses of the filter
+        inline bool _absent(const coord_t& coord) const
+        {
+            return _filter && !_cmapbase::_probe<_Tc, _DIM, false>(*_filter, coord);
+        }
+
+        // Weight of the data at coord (0 if absent or if no weight is tracked)
+        inline double _weight_of(const coord_t& coord) const
+        {
+            if (!_weight)
+                return 0.0;
+            const node_t& leaf = _cmapbase::_leaf(*_root, coord);
+            auto pos = _cmapbase::_pair(leaf, coord);
+            return (pos == _cmapbase::_data(leaf)->end()) ? 0.0 : _weight((*pos).second);
+        }
+
+        // Forget the tracked bounds and sums on the path to coord, whose data is handed out for writing (through operator[] or an iterator)
+        inline void _untrack(const coord_t& coord) const
+        {
+            if (_key || _weight)
+                _cmapbase::_forget(*_root, coord);
+        }
+
+        // Recompute the tracked bounds and sums which were forgotten, so that later queries need not
+        inline void _settle()
+        {
+            if (_key && _cmapbase::_children(*_root))
+                _cmapbase::_peak<true>(*_root, _key);
+            if (_weight && _cmapbase::_children(*_root))
+                _cmapbase::_weigh<true>(*_root, _weight);
+        }
+
+        // Update the filter, and the tracked bounds and sums on the path to coord, whose weight was before
+        inline void _track(const coord_t& coord, const double before)
+        {
+            _settle();
+            if (_filter)
+            {
+                if (_size > _filter->_capacity)
+                    _refilter();
+                else
+                    _cmapbase::_probe<_Tc, _DIM, true>(*_filter, coord);
+            }
+            if (_key)
+                _cmapbase::_raise(*_root, coord, _key);
+            if (_weight)
+                _cmapbase::_reweigh(*_root, coord, _weight, before);
+        }
+
+        // Rebuild the filter, and recompute the tracked bounds and sums
+        inline void _retrack()
+        {
+            if (_filter)
+                _refilter();
+            if (_key)
+                _cmapbase::_bound(*_root, _key);
+            if (_weight)
+                _cmapbase::_total(*_root, _weight);
+        }
+
+        template<class _Tm, class _Tr>
+        inline auto _sample(_Tr& rng, const size_t number, const double total, const _Tm& measure, const bool discrete) const
+        {
+            std::vector<double> positions(number);
+            if (discrete)
+            {
+                std::uniform_int_distribution<size_t> distribution(0U, _size - 1U);
+                for (double& position : positions)
+                    position = distribution(rng) + 0.5;
+            }
+            else
+            {
+                std::uniform_real_distribution<double> distribution(0.0, total);
+                for (double& position : positions)
+                    position = distribution(rng);
+            }
+            std::sort(positions.begin(), positions.end());
+            std::vector<std::pair<const node_t *, typename data_vec::iterator>> items;
+            items.reserve(number);
+            _cmapbase::_select(*_root, positions.begin(), positions.end(), 0.0, measure, items);
+            std::vector<const_iterator> result;
+            result.reserve(number);
+            for (const auto& item : items)
+                result.push_back(const_iterator(*this, item.first, item.second));
+            return result;
+        }
+
+        template<class, size_t, class> friend class cmap;
+
+        // Replace the content by data, which holds distinct (resized) coordinates in Morton order
+        inline void _assign(data_vec& data, const uint8_t num_resizes)
+        {
+            clear();
+            _num_resizes   = num_resizes;
+            _size          = data.size();
+            _root->_level -= num_resizes;
+            if (_size > 16384U)
+            {
+                #pragma omp parallel
+                #pragma omp single
+                _cmapbase::_build(*_root, data.begin(), data.end());
+            }
+            else
+                _cmapbase::_build(*_root, data.begin(), data.end());
+            assert(_size == _cmapbase::_tally(*_root));
+            _retrack();
+        }
 
+        // Iterators keep the indices of the children taken from the root down to their leaf (at most 8 * sizeof(_Tc) - 1), instead of parent pointers in the nodes
+        // begin, rbegin and find record them during their descent; iterators from top_k or sample trace them (by one descent from _root) when they first leave their leaf
         template<class _Type, typename _vIt>
         class _iterator_base
         {
             private:
 
-                const node_t * _node;
-                _vIt           _vitr;
+                const cmap *                                        _map;
+                const node_t *                                      _node;
+                _vIt                                                _vitr;
+                mutable std::array<uint8_t, 8U * sizeof(_Tc)>       _path;
+                mutable uint8_t                                     _depth;
+                mutable bool                                        _traced;
+
+                template<class, typename> friend class _iterator_base;
+
+                inline void _trace() const
+                {
+                    if (_traced)
+                        return;
+                    _depth = 0U;
+                    const node_t * leaf = _cmapbase::_descend(*(_map->_root), (*_vitr).first, &_path[0], _depth);
+                    assert(leaf == _node);
+                    (void)leaf;
+                    _traced = true;
+                }
 
                 template <class T = void>
                 inline typename std::enable_if<std::is_same<_vIt, typename data_vec::iterator>::value, T>::type update()
                 {
                     assert(_node);
-                    if (++_vitr == _node->_data->end())
+                    if (std::next(_vitr) != _cmapbase::_data(*_node)->end())
+                        ++_vitr;
+                    else
                     {
-                        _node = _cmapbase::_next<typename node_arr::const_iterator>(*_node);
-                        _vitr = (_node) ? _node->_data->begin() : vvoid();
+                        _trace();
+                        _node = _cmapbase::_next<true>(*_node, *(_map->_root), &_path[0], _depth);
+                        _vitr = (_node) ? _cmapbase::_data(*_node)->begin() : vvoid();
                     }
                 }
 
@@ -482,10 +2171,13 @@ class cmap {
                 inline typename std::enable_if<std::is_same<_vIt, typename data_vec::reverse_iterator>::value, T>::type update()
                 {
                     assert(_node);
-                    if (++_vitr == _node->_data->rend())
+                    if (std::next(_vitr) != _cmapbase::_data(*_node)->rend())
+                        ++_vitr;
+                    else
                     {
-                        _node = _cmapbase::_next<typename node_arr::const_reverse_iterator>(*_node);
-                        _vitr = (_node) ? _node->_data->rbegin() : vvoid();
+                        _trace();
+                        _node = _cmapbase::_next<false>(*_node, *(_map->_root), &_path[0], _depth);
+                        _vitr = (_node) ? _cmapbase::_data(*_node)->rbegin() : vvoid();
                     }
                 }
 
@@ -493,29 +2185,54 @@ class cmap {
 
             public:
 
-                _iterator_base() : _node(nullptr), _vitr(vvoid()) {}
-                _iterator_base(const node_t * node_in, _vIt vitr_in) : _node(node_in), _vitr(vitr_in) {}
-                _iterator_base(const _iterator_base& in) : _node(in._node), _vitr(in._vitr) {}
+                _iterator_base() : _map(nullptr), _node(nullptr), _vitr(vvoid()), _depth(0U), _traced(true) {}
+                _iterator_base(const cmap& map, const node_t * node_in, _vIt vitr_in) : _map(&map), _node(node_in), _vitr(vitr_in), _depth(0U), _traced(false) {}
+                _iterator_base(const cmap& map, const node_t * node_in, _vIt vitr_in, const uint8_t * path, const uint8_t depth) : _map(&map), _node(node_in), _vitr(vitr_in), _depth(depth), _traced(true)
+                {
+                    std::copy(path, path + depth, _path.begin());
+                }
                 _iterator_base& operator++() { this->update(); return *this; }
                 _iterator_base  operator++(int) { _iterator_base returnval = *this; this->update(); return returnval; }
-                bool operator==(_iterator_base other) const noexcept { return (_node == other._node) && (_vitr == other._vitr); }
-                bool operator!=(_iterator_base other) const noexcept { return (_node != other._node) || (_vitr != other._vitr); }
+                bool operator==(const _iterator_base& other) const noexcept { return (_node == other._node) && (_vitr == other._vitr); }
+                bool operator!=(const _iterator_base& other) const noexcept { return (_node != other._node) || (_vitr != other._vitr); }
                 const node_t * node() const { return _node; }
                 _vIt viter() const { return _vitr; }
+                const uint8_t * path() const { _trace(); return &_path[0]; }
+                uint8_t depth() const { _trace(); return _depth; }
+
+                // Move to the first item of the next leaf with data (the items of the current leaf may have been erased)
+                template <class T = void>
+                inline typename std::enable_if<std::is_same<_vIt, typename data_vec::iterator>::value, T>::type leap()
+                {
+                    assert(_node && _traced);
+                    _node = _cmapbase::_next<true>(*_node, *(_map->_root), &_path[0], _depth);
+                    _vitr = (_node) ? _cmapbase::_data(*_node)->begin() : vvoid();
+                }
 
                 template <class T = const pair_t&>
                 inline typename std::enable_if<std::is_const<_Type>::value, T>::type operator*() const { return *_vitr; }
 
+                // Writable access forgets the tracked bounds on the path of the item, which are recomputed when next needed
                 template <class T = std::pair<const coord_t&, _Td&>>
-                inline typename std::enable_if<!std::is_const<_Type>::value, T>::type operator*() const { return { (*_vitr).first, (*_vitr).second }; }
+                inline typename std::enable_if<!std::is_const<_Type>::value, T>::type operator*() const { _map->_untrack((*_vitr).first); return { (*_vitr).first, (*_vitr).second }; }
 
                 template <class T = const pair_t&>
                 inline typename std::enable_if<std::is_const<_Type>::value, T>::type operator->() const { return *_vitr; }
 
                 template <class T = std::pair<const coord_t&, _Td&>>
-                inline typename std::enable_if<!std::is_const<_Type>::value, T>::type operator->() const { return { (*_vitr).first, (*_vitr).second }; }
+                inline typename std::enable_if<!std::is_const<_Type>::value, T>::type operator->() const { _map->_untrack((*_vitr).first); return { (*_vitr).first, (*_vitr).second }; }
 
-                operator _iterator_base<const _Type, _vIt>() const { return _iterator_base<const _Type, _vIt>(_node, _vitr); }
+                operator _iterator_base<const _Type, _vIt>() const
+                {
+                    _iterator_base<const _Type, _vIt> result;
+                    result._map    = _map;
+                    result._node   = _node;
+                    result._vitr   = _vitr;
+                    result._path   = _path;
+                    result._depth  = _depth;
+                    result._traced = _traced;
+                    return result;
+                }
         };
 
     public:
@@ -534,21 +2251,58 @@ class cmap {
         cmap& operator=(const cmap&) = delete;
         cmap& operator=(cmap&&) = delete;
 
-        inline void insert(const coord_t& coord, const _Td& data)
+        inline void insert(const coord_t& coord, const _Td& data) { insert(coord, data, _cmapbase::merge_t()); }
+
+        // With combine(left = present, right = data) instead of merge when coord is present
+        template<class _Tf>
+        inline void insert(const coord_t& coord, const _Td& data, _Tf combine)
+        {
+            const double before = _weight_of(coord);
+            _size += _cmapbase::_insert(*_root, coord, data, combine);
+            _track(coord, before);
+        }
+
+        // Insert a batch of items, which is reordered in the process
+        // Only an empty map is built from the batch in one pass; into a non-empty map, the items are inserted one by one (in Morton order, which only helps the cache)
+        inline void insert(std::vector<pair_t>& batch)
+        {
+            _cmapbase::_sort_merge(batch);
+            if (empty())
+            {
+                _assign(batch, _num_resizes);
+                return;
+            }
+            for (const auto& item : batch)
+                insert(item.first, item.second);
+        }
+
+        // Replace the content by data (whose items are moved), which holds distinct coordinates (resized num_resizes times) in Morton order
+        inline void assign(std::vector<pair_t>& data, const uint8_t num_resizes = 0U)
         {
-            _size += _cmapbase::_insert(_leaf(*_root, coord), coord, data);
+            assert(std::adjacent_find(data.begin(), data.end(), [](const pair_t& left, const pair_t& right)
+                { return !_cmapbase::_morton_less(left.first, right.first); }) == data.end());
+            _assign(data, num_resizes);
         }
 
         template<class ... _Ts>
         inline void emplace(const coord_t& coord, _Ts&& ... args)
         {
-            _size += _cmapbase::_emplace(_leaf(*_root, coord), coord, args ...);
+            const double before = _weight_of(coord);
+            _size += _cmapbase::_emplace(*_root, coord, args ...);
+            _track(coord, before);
         }
 
-        inline void resize()
+        inline void resize() { resize(_cmapbase::merge_t()); }
+
+        // With combine(left, right) instead of merge for colliding data
+        template<class _Tf>
+        inline void resize(_Tf combine)
         {
-            _size -= _cmapbase::_resize(*_root);
+            _thaw_all();
+            _size -= _cmapbase::_resize(*_root, combine);
             ++_num_resizes;
+            assert(_size == _cmapbase::_tally(*_root));
+            _retrack();
         }
 
         inline uint8_t num_resizes() const { return _num_resizes; }
@@ -559,6 +2313,26 @@ class cmap {
 
         inline void prune() const { _prune(*_root); }
 
+        // Prune and reallocate the tree in depth-first order (memory peaks at twice the tree); invalidates iterators
+        inline void compact()
+        {
+            _cmapbase::_prune(*_root);
+            auto fresh = std::make_unique<node_t>();
+            _cmapbase::_compact(*fresh, *_root);
+            _root = std::move(fresh);
+        }
+
+        // Compress the leafs which were not accessed since the previous call (requires a trivially copyable _Td)
+        // Const accesses decompress the leafs they visit, so concurrent readers of a compressed map need external synchronisation
+        inline size_t compress_idle()
+        {
+            const size_t number = _cmapbase::_sweep(*_root);
+            _frozen = _frozen || (number != 0U);
+            return number;
+        }
+
+        inline size_t memory() const { return sizeof(cmap) + sizeof(node_t) + _cmapbase::_memory(*_root); }
+
         inline void clear()
         {
             assert(_cmapbase::_template_checks(static_cast<_Tc>(7U), _DIM));
@@ -566,76 +2340,94 @@ class cmap {
             _size = 0U;
             if (_root){ _root.reset(nullptr); }
             _root = std::make_unique<node_t>();
-            _root->_data     = std::make_unique<data_vec>();
-            _root->_children = nullptr;
-            _root->_parent   = nullptr;
+            _cmapbase::_hold(*_root, std::make_unique<data_vec>());
+            _root->_count    = 0U;
             _root->_level    = 8U * sizeof(_Tc) - 1U;
-            _root->_data->reserve(1U << _DIM);
+            _cmapbase::_data(*_root)->reserve(1U << _DIM);
+            _frozen = false;
+            if (_filter)
+                _refilter();
         }
 
-        inline iterator begin() const noexcept
+        // begin and rbegin may throw, as they decompress the first (last) leaf if it is cold
+        inline iterator begin() const
         {
             if (empty())
                 return end();
-            const node_t * first = _cmapbase::_down<typename node_arr::const_iterator>(*_root);
-            return iterator(first, first->_data->begin());
+            std::array<uint8_t, 8U * sizeof(_Tc)> path;
+            uint8_t depth = 0U;
+            const node_t * first = _cmapbase::_down<true>(*_root, &path[0], depth);
+            return iterator(*this, first, _cmapbase::_data(*first)->begin(), &path[0], depth);
         }
 
-        inline const_iterator cbegin() const noexcept { return begin(); }
+        inline const_iterator cbegin() const { return begin(); }
         inline iterator          end() const noexcept { return iterator(); }
         inline const_iterator   cend() const noexcept { return end(); }
 
-        inline reverse_iterator rbegin() const noexcept
+        inline reverse_iterator rbegin() const
         {
             if (empty())
                 return rend();
-            const node_t * last = _cmapbase::_down<typename node_arr::const_reverse_iterator>(*_root);
-            return reverse_iterator(last, last->_data->rbegin());
+            std::array<uint8_t, 8U * sizeof(_Tc)> path;
+            uint8_t depth = 0U;
+            const node_t * last = _cmapbase::_down<false>(*_root, &path[0], depth);
+            return reverse_iterator(*this, last, _cmapbase::_data(*last)->rbegin(), &path[0], depth);
         }
 
-        inline const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+        inline const_reverse_iterator crbegin() const { return rbegin(); }
         inline       reverse_iterator    rend() const noexcept { return reverse_iterator(); }
         inline const_reverse_iterator   crend() const noexcept { return rend(); }
 
         inline iterator find(const coord_t& coord) const
         {
-            const node_t& leaf = _cmapbase::_leaf(*_root, coord);
-            auto pos = _cmapbase::_pair(leaf, coord);
-            if (pos == leaf._data->end())
+            if (_absent(coord))
+                return end();
+            std::array<uint8_t, 8U * sizeof(_Tc)> path;
+            uint8_t depth = 0U;
+            const node_t * leaf = _cmapbase::_descend(*_root, coord, &path[0], depth);
+            auto pos = _cmapbase::_pair(*leaf, coord);
+            if (pos == _cmapbase::_data(*leaf)->end())
                 return end();
             else
-                return iterator(&leaf, pos);
+                return iterator(*this, leaf, pos, &path[0], depth);
         }
 
         inline _Td& operator[](const coord_t& coord)
         {
             node_t& leaf = _cmapbase::_leaf(*_root, coord);
             auto pos = _cmapbase::_pair(leaf, coord);
-            if (pos == leaf._data->end())
+            if (pos == _cmapbase::_data(leaf)->end())
             {
-                _size += _cmapbase::_insert(leaf, coord, _Td());
+                _size += _cmapbase::_insert(*_root, coord, _Td(), _cmapbase::merge_t());
+                _track(coord, 0.0);
                 pos = _cmapbase::_pair(_cmapbase::_leaf(leaf, coord), coord);
             }
+            _untrack(coord);
             return (*pos).second;
         }
 
         inline bool contains(const coord_t& coord) const
         {
+            if (_absent(coord))
+                return false;
             const node_t& leaf = _cmapbase::_leaf(*_root, coord);
             auto pos = _cmapbase::_pair(leaf, coord);
-            return pos != leaf._data->end();
+            return pos != _cmapbase::_data(leaf)->end();
         }
 
         inline size_t erase(const coord_t& coord)
         {
-            node_t& leaf = _cmapbase::_leaf(*_root, coord);
-            auto pos = _cmapbase::_pair(leaf, coord);
-            if (pos == leaf._data->end())
+            if (_absent(coord))
+                return 0U;
+            const double weight = _weight_of(coord);
+            if (_cmapbase::_erase(*_root, coord) == 0U)
                 return 0U;
-            leaf._data->erase(pos);
+            if (_weight)
+                _cmapbase::_subtract(*_root, coord, weight);
             --_size;
+            _unfilter(1U);
             _cmapbase::_prune(*_root);
-            assert(_size == _cmapbase::_size(*_root));
+            assert(_size == _cmapbase::_tally(*_root));
             return 1U;
         }
 
@@ -643,10 +2435,12 @@ class cmap {
         {
             if (iter.node() == nullptr)
                 return 0U;
-            iter.node()->_data->erase(iter.viter());
+            _cmapbase::_discount(*_root, iter.path(), iter.depth(), 1U, _weight ? _weight((*(iter.viter())).second) : 0.0);
+            _cmapbase::_data(*iter.node())->erase(iter.viter());
             --_size;
             _cmapbase::_prune(*_root);
-            assert(_size == _cmapbase::_size(*_root));
+            assert(_size == _cmapbase::_tally(*_root));
+            _unfilter(1U);
             return 1U;
         }
 
@@ -658,18 +2452,305 @@ class cmap {
             while ((iter != end) && (iter != stop))
             {
                 auto dbegin = iter.viter();
-                auto dend   = (iter.node() == stop.node()) ? stop.viter() : iter.node()->_data->end();
+                auto dend   = (iter.node() == stop.node()) ? stop.viter() : _cmapbase::_data(*iter.node())->end();
                 number += dend - dbegin;
-                iter.node()->_data->erase(dbegin, dend);
-                const node_t * next = _cmapbase::_next<typename node_arr::const_iterator>(*iter.node());
-                iter = ((iter.node() != stop.node()) && next) ? const_iterator(next, next->_data->begin()) : end;
+                double weight = 0.0;
+                for (auto item = dbegin; _weight && (item != dend); ++item)
+                    weight += _weight((*item).second);
+                _cmapbase::_discount(*_root, iter.path(), iter.depth(), dend - dbegin, weight);
+                _cmapbase::_data(*iter.node())->erase(dbegin, dend);
+                if (iter.node() == stop.node())
+                    break;
+                iter.leap();
             }
             _size -= number;
             _cmapbase::_prune(*_root);
-            assert(_size == _cmapbase::_size(*_root));
+            assert(_size == _cmapbase::_tally(*_root));
+            _unfilter(number);
+            return number;
+        }
+
+        inline void merge_union(cmap& other) { merge_union(other, _cmapbase::merge_t()); }
+
+        // With combine(left = this, right = other) instead of merge for data at the same coordinates
+        template<class _Tf>
+        inline void merge_union(cmap& other, _Tf combine)
+        {
+            _thaw_all();
+            other._thaw_all();
+            assert(&other != this);
+            assert(_num_resizes == other._num_resizes);
+            _size += _cmapbase::_union(*_root, *(other._root), combine);
+            other._size = 0U;
+            _cmapbase::_prune(*(other._root));
+            other._retrack();
+            assert(_size == _cmapbase::_tally(*_root));
+            _retrack();
+        }
+
+        template<class _Tf>
+        inline size_t intersect(const cmap& other, _Tf combine)
+        {
+            _thaw_all();
+            other._thaw_all();
+            assert(&other != this);
+            assert(_num_resizes == other._num_resizes);
+            const size_t number = _cmapbase::_intersect(*_root, *(other._root), combine);
+            _size -= number;
+            _cmapbase::_prune(*_root);
+            assert(_size == _cmapbase::_tally(*_root));
+            _retrack();
+            return number;
+        }
+
+        inline size_t difference(const cmap& other)
+        {
+            _thaw_all();
+            other._thaw_all();
+            assert(&other != this);
+            assert(_num_resizes == other._num_resizes);
+            const size_t number = _cmapbase::_difference(*_root, *(other._root));
+            _size -= number;
+            _cmapbase::_prune(*_root);
+            assert(_size == _cmapbase::_tally(*_root));
+            _retrack();
             return number;
         }
 
+        template<class _Ta, class _Tr, class _Tm, class _Te>
+        friend inline void diff(const cmap& a, const cmap& b, _Ta on_added, _Tr on_removed, _Tm on_changed, _Te equal)
+        {
+            assert(a._num_resizes == b._num_resizes);
+            _cmapbase::_diff(*(a._root), *(b._root), on_added, on_removed, on_changed, equal);
+        }
+
+        template<class _Ta, class _Tr, class _Tm>
+        friend inline void diff(const cmap& a, const cmap& b, _Ta on_added, _Tr on_removed, _Tm on_changed)
+        {
+            diff(a, b, on_added, on_removed, on_changed, [](const _Td& left, const _Td& right){ return left == right; });
+        }
+
+        inline bool operator==(const cmap& other) const
+        {
+            auto equal = [](const _Td& left, const _Td& right){ return left == right; };
+            return (_num_resizes == other._num_resizes) && (_size == other._size)
+                && _cmapbase::_equal(*_root, *(other._root), equal);
+        }
+
+        inline bool operator!=(const cmap& other) const { return !(*this == other); }
+
+        static constexpr size_t num_neighbours = _cmapbase::_num_neighbours(_DIM);
+
+        template<class _Tf>
+        inline void for_each_with_neighbours(_Tf f) const
+        {
+            std::array<node_t *, 8U * sizeof(_Tc)> path;
+            std::array<const pair_t *, num_neighbours> neighbours;
+            _cmapbase::_stencil(*_root, &path[0], 0U, neighbours, f);
+        }
+
+        inline std::vector<size_t> connected_components(const connectivity conn) const
+        {
+            // Every pair of neighbours is joined once: from the one for which the other lies at a lower offset
+            std::vector<size_t> codes;
+            for (size_t k = 0U; k < num_neighbours / 2U; ++k)
+            {
+                size_t num_nonzero = 0U;
+                size_t digits = k;
+                for (size_t idx = 0U; idx < _DIM; ++idx, digits /= 3U)
+                    num_nonzero += ((digits % 3U) != 1U) ? 1U : 0U;
+                if ((conn == connectivity::full) || (num_nonzero == 1U))
+                    codes.push_back(k);
+            }
+
+            std::unordered_map<const node_t *, size_t> bases;
+            size_t index = 0U;
+            _cmapbase::_bases(*_root, bases, index);
+            assert(index == _size);
+
+            std::vector<size_t> labels(_size);
+            for (size_t element = 0U; element < _size; ++element)
+                labels[element] = element;
+            std::array<node_t *, 8U * sizeof(_Tc)> path;
+            index = 0U;
+            _cmapbase::_join(*_root, &path[0], 0U, codes, bases, labels, index);
+
+            // Number the components in order of first appearance (the representative is the first element of each set)
+            for (size_t element = 0U; element < _size; ++element)
+                labels[element] = _cmapbase::_find_set(labels, element);
+            size_t num_labels = 0U;
+            for (size_t element = 0U; element < _size; ++element)
+                labels[element] = (labels[element] == element) ? num_labels++ : labels[labels[element]];
+            return labels;
+        }
+
+        // Keep an upper bound on key(data) per subtree for top_k; writable access through operator[] or iterator forgets the bounds
+        // on the path of the entry until they are next needed, so read a tracked map through const_iterator
+        inline void track_max(const std::function<double(const _Td&)>& key)
+        {
+            _thaw_all();
+            _key = key;
+            if (_key)
+                _cmapbase::_bound(*_root, _key);
+        }
+
+        inline std::vector<const_iterator> top_k(const size_t k) const
+        {
+            assert(_key);
+            std::vector<std::pair<const node_t *, typename data_vec::iterator>> items;
+            items.reserve(std::min(k, _size));
+            _cmapbase::_top_k(*_root, k, _key, items);
+            std::vector<const_iterator> result;
+            result.reserve(items.size());
+            for (const auto& item : items)
+                result.push_back(const_iterator(*this, item.first, item.second));
+            return result;
+        }
+
+        // Attach a blocked Bloom filter on the coordinates, which find, contains and erase consult first (0 removes it)
+        inline void use_filter(const size_t bits_per_entry = 10U)
+        {
+            if (bits_per_entry == 0U)
+            {
+                _filter.reset(nullptr);
+                return;
+            }
+            _filter = std::make_unique<_cmapbase::filter_t<_Tc, _DIM>>();
+            _filter->_bits   = bits_per_entry;
+            _filter->_probes = std::min(std::max(static_cast<size_t>(0.693 * bits_per_entry + 0.5), static_cast<size_t>(1U)), static_cast<size_t>(7U));
+            _refilter();
+        }
+
+        // Keep the sum of weight(data) per subtree for weighted_sample; forgotten by writable access as the bounds of track_max
+        inline void track_sum(const std::function<double(const _Td&)>& weight)
+        {
+            _thaw_all();
+            _weight = weight;
+            if (_weight)
+                _cmapbase::_total(*_root, _weight);
+        }
+
+        template<class _Tr>
+        inline std::vector<const_iterator> sample(_Tr& rng, const size_t number) const
+        {
+            struct counter
+            {
+                double node(const node_t& child) const { return static_cast<double>(_cmapbase::_size(child)); }
+                double item(const _Td&) const { return 1.0; }
+            };
+            if (empty())
+                return std::vector<const_iterator>();
+            return _sample(rng, number, static_cast<double>(_size), counter(), true);
+        }
+
+        template<class _Tr>
+        inline std::vector<const_iterator> weighted_sample(_Tr& rng, const size_t number) const
+        {
+            struct weigher
+            {
+                const std::function<double(const _Td&)>& weight;
+                double node(const node_t& child) const { return _cmapbase::_weigh<false>(child, weight); }
+                double item(const _Td& data) const { return weight(data); }
+            };
+            assert(_weight);
+            const double total = _cmapbase::_weigh<false>(*_root, _weight);
+            if (!(total > 0.0))
+                return std::vector<const_iterator>();
+            return _sample(rng, number, total, weigher{ _weight }, false);
+        }
+
+        template<class _Tr>
+        inline const_iterator sample(_Tr& rng) const
+        {
+            std::vector<const_iterator> result = sample(rng, 1U);
+            return result.empty() ? cend() : result[0];
+        }
+
+        template<class _Tr>
+        inline const_iterator weighted_sample(_Tr& rng) const
+        {
+            std::vector<const_iterator> result = weighted_sample(rng, 1U);
+            return result.empty() ? cend() : result[0];
+        }
+
+        template<class _Tf>
+        inline void slice(const size_t dim, const _Tc value, _Tf f) const
+        {
+            assert(dim < _DIM);
+            if (_cmapbase::_covers(*_root, value))
+                _cmapbase::_slice(*_root, dim, value, f);
+        }
+
+        inline void slice(const size_t dim, const _Tc value, cmap<_Tc, _DIM - 1U, _Td>& target) const
+        {
+            typedef typename cmap<_Tc, _DIM - 1U, _Td>::pair_t target_pair_t;
+            typename cmap<_Tc, _DIM - 1U, _Td>::data_vec data;
+            slice(dim, value, [&](const pair_t& item)
+            {
+                typename cmap<_Tc, _DIM - 1U, _Td>::coord_t coord;
+                std::copy(item.first.begin(), item.first.begin() + dim, coord.begin());
+                std::copy(item.first.begin() + dim + 1U, item.first.end(), coord.begin() + dim);
+                data.push_back({ coord, item.second });
+            });
+            // Dropping a coordinate which is equal for all items preserves the Morton order of the leafs, but not within a leaf
+            // so the slice is sorted as a whole before the bulk build
+            std::sort(data.begin(), data.end(), [](const target_pair_t& left, const target_pair_t& right)
+                { return _cmapbase::_morton_less(left.first, right.first); });
+            target._assign(data, _num_resizes);
+        }
+
+        template<class _Tf>
+        inline void for_each_hilbert(_Tf f) const
+        {
+            _cmapbase::hilbert_t<_DIM> state;
+            for (uint8_t idx = 0U; idx < _DIM; ++idx)
+                state._axes[idx] = idx;
+            state._flips  = 0U;
+            state._parity = 0U;
+            // The levels above the root have all bits zero
+            for (size_t level = 8U * sizeof(_Tc) - 1U; level > _root->_level; --level)
+                _cmapbase::_hilbert_step(state, 0U);
+            _cmapbase::_hilbert(*_root, state, f);
+        }
+
+        template<size_t ... _dims>
+        inline void project(cmap<_Tc, sizeof...(_dims), _Td>& target) const
+        {
+            static_assert(sizeof...(_dims) > 0U, "cmap::project requires at least one dimension");
+            static_assert(_cmapbase::_valid_dims(_DIM, _dims ...), "cmap::project requires dimensions smaller than _DIM");
+            typedef cmap<_Tc, sizeof...(_dims), _Td> target_t;
+            typedef typename target_t::pair_t        target_pair_t;
+            typedef std::vector<target_pair_t>       target_vec;
+
+            // Project the subtrees of the root in parallel
+            const size_t num_parts = (_cmapbase::_children(*_root)) ? (1U << _DIM) : 1U;
+            std::vector<target_vec> parts(num_parts);
+            #pragma omp parallel for schedule(dynamic) if (_size > 16384U)
+            for (size_t idx = 0U; idx < num_parts; ++idx)
+            {
+                const node_t& node = (_cmapbase::_children(*_root)) ? (*(_cmapbase::_children(*_root)))[idx] : *_root;
+                parts[idx].reserve(_cmapbase::_size(node));
+                auto projector = [&](const pair_t& item)
+                {
+                    parts[idx].push_back({ { item.first[_dims] ... }, item.second });
+                };
+                _cmapbase::_for_each(node, projector);
+            }
+
+            target_vec data;
+            data.reserve(_size);
+            for (auto& part : parts)
+            {
+                data.insert(data.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+                target_vec().swap(part);
+            }
+
+            // Sort in Morton order and merge collapsed cells (stable: merged in iteration order)
+            _cmapbase::_sort_merge(data);
+
+            target._assign(data, _num_resizes);
+        }
+
 
 };
 
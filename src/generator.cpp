@@ -73,11 +73,74 @@ void unravel_printer(std::ofstream& output, const std::string& Type, const uint3
     output << "}" << std::endl << std::endl << std::endl;
 }
 
-int main()
+void hilbert_printer(std::ofstream& output, const std::string& Type, const uint32_t NBITS, const uint32_t DIM)
 {
-    std::ofstream output;
-    output.open("permutation.hpp", std::ios::out | std::ios::trunc);
+    /*
+        Skilling's transpose algorithm, unrolled over the dimensions:
+            * axes to transpose: undo the excess work per bit (from MSB to LSB), Gray encode, and fix the parity
+            * the transpose has X[0] as most significant bit of every group: reversed for permute (coord[DIM - 1] most significant)
+    */
 
+    output << "template<> inline constexpr void hilbert<" << Type << ", " << DIM << ">(const " << Type << " * coord, " << Type << " * index) noexcept" << std::endl;
+    output << "{" << std::endl;
+    output << "    " << Type << " X[" << DIM << "] = { ";
+    for (uint32_t ic = 0U; ic < DIM; ++ic)
+        output << "coord[" << ic << "]" << ((ic + 1U == DIM) ? " };" : ", ");
+    output << std::endl;
+    output << "    " << Type << " t = 0U;" << std::endl;
+    output << "    for (" << Type << " Q = static_cast<" << Type << ">(1U) << " << NBITS - 1U << "; Q > 1U; Q >>= 1U)" << std::endl;
+    output << "    {" << std::endl;
+    output << "        const " << Type << " P = Q - 1U;" << std::endl;
+    output << "        if (X[0] & Q) { X[0] ^= P; }" << std::endl;
+    for (uint32_t ic = 1U; ic < DIM; ++ic)
+        output << "        if (X[" << ic << "] & Q) { X[0] ^= P; } else { t = (X[0] ^ X[" << ic << "]) & P; X[0] ^= t; X[" << ic << "] ^= t; }" << std::endl;
+    output << "    }" << std::endl;
+    for (uint32_t ic = 1U; ic < DIM; ++ic)
+        output << "    X[" << ic << "] ^= X[" << ic - 1U << "];" << std::endl;
+    output << "    t = 0U;" << std::endl;
+    output << "    for (" << Type << " Q = static_cast<" << Type << ">(1U) << " << NBITS - 1U << "; Q > 1U; Q >>= 1U)" << std::endl;
+    output << "        if (X[" << DIM - 1U << "] & Q) { t ^= Q - 1U; }" << std::endl;
+    output << "    const " << Type << " Y[" << DIM << "] = { ";
+    for (uint32_t ic = 0U; ic < DIM; ++ic)
+        output << "static_cast<" << Type << ">(X[" << DIM - 1U - ic << "] ^ t)" << ((ic + 1U == DIM) ? " };" : ", ");
+    output << std::endl;
+    output << "    permute<" << Type << ", " << DIM << ">(Y, index);" << std::endl;
+    output << "}" << std::endl << std::endl << std::endl;
+}
+
+void unhilbert_printer(std::ofstream& output, const std::string& Type, const uint32_t NBITS, const uint32_t DIM)
+{
+    /*
+        Inverse of hilbert_printer: Gray decode, and redo the excess work per bit (from LSB to MSB)
+    */
+
+    output << "template<> inline constexpr void unhilbert<" << Type << ", " << DIM << ">(const " << Type << " * index, " << Type << " * coord) noexcept" << std::endl;
+    output << "{" << std::endl;
+    output << "    " << Type << " Y[" << DIM << "] = { };" << std::endl;
+    output << "    unravel<" << Type << ", " << DIM << ">(index, Y);" << std::endl;
+    output << "    " << Type << " X[" << DIM << "] = { ";
+    for (uint32_t ic = 0U; ic < DIM; ++ic)
+        output << "Y[" << DIM - 1U - ic << "]" << ((ic + 1U == DIM) ? " };" : ", ");
+    output << std::endl;
+    output << "    " << Type << " t = X[" << DIM - 1U << "] >> 1U;" << std::endl;
+    for (uint32_t ic = DIM - 1U; ic > 0U; --ic)
+        output << "    X[" << ic << "] ^= X[" << ic - 1U << "];" << std::endl;
+    output << "    X[0] ^= t;" << std::endl;
+    output << "    for (uint32_t bit = 1U; bit < " << NBITS << "U; ++bit)" << std::endl;
+    output << "    {" << std::endl;
+    output << "        const " << Type << " Q = static_cast<" << Type << ">(1U) << bit;" << std::endl;
+    output << "        const " << Type << " P = Q - 1U;" << std::endl;
+    for (uint32_t ic = DIM - 1U; ic > 0U; --ic)
+        output << "        if (X[" << ic << "] & Q) { X[0] ^= P; } else { t = (X[0] ^ X[" << ic << "]) & P; X[0] ^= t; X[" << ic << "] ^= t; }" << std::endl;
+    output << "        if (X[0] & Q) { X[0] ^= P; }" << std::endl;
+    output << "    }" << std::endl;
+    for (uint32_t ic = 0U; ic < DIM; ++ic)
+        output << "    coord[" << ic << "] = X[" << ic << "];" << std::endl;
+    output << "}" << std::endl << std::endl << std::endl;
+}
+
+void license_printer(std::ofstream& output)
+{
     output << "/*" << std::endl
            << "    cmap is a resizable coordinate map" << std::endl
            << std::endl
@@ -89,6 +152,16 @@ int main()
            << "    folder of this project." << std::endl
            << "*/" << std::endl
            << std::endl
+           << std::endl;
+}
+
+int main()
+{
+    std::ofstream output;
+    output.open("permutation.hpp", std::ios::out | std::ios::trunc);
+
+    license_printer(output);
+    output << "#pragma once" << std::endl
            << std::endl
            << "namespace tools" << std::endl
            << "{" << std::endl
@@ -100,10 +173,10 @@ int main()
            << "inline constexpr void unravel(const _Type * perm, _Type * coord) noexcept;" << std::endl
            << std::endl;
 
-    for (uint32_t bit = 16; bit <= 64; bit *= 2)
+    for (uint32_t bit = 16; bit <= 128; bit *= 2)
     {
         std::stringstream _Typename;
-        _Typename << "uint" << bit << "_t";
+        _Typename << ((bit == 128) ? "__" : "") << "uint" << bit << "_t";
         for (uint32_t dim = 2; dim <= 8; ++dim)
         {
             permute_printer(output, _Typename.str(), bit, dim);
@@ -113,6 +186,38 @@ int main()
 
     output << "} // End of namespace cmap" << std::endl;
     output << std::endl << std::endl;
+    output.close();
+
+    output.open("hilbert.hpp", std::ios::out | std::ios::trunc);
+
+    license_printer(output);
+    output << "#pragma once" << std::endl
+           << std::endl
+           << "#include \"permutation.hpp\"" << std::endl
+           << std::endl
+           << "namespace tools" << std::endl
+           << "{" << std::endl
+           << std::endl
+           << "template<class _Type, size_t _DIM>" << std::endl
+           << "inline constexpr void hilbert(const _Type * coord, _Type * index) noexcept;" << std::endl
+           << std::endl
+           << "template<class _Type, size_t _DIM>" << std::endl
+           << "inline constexpr void unhilbert(const _Type * index, _Type * coord) noexcept;" << std::endl
+           << std::endl;
+
+    for (uint32_t bit = 16; bit <= 128; bit *= 2)
+    {
+        std::stringstream _Typename;
+        _Typename << ((bit == 128) ? "__" : "") << "uint" << bit << "_t";
+        for (uint32_t dim = 2; dim <= 8; ++dim)
+        {
+            hilbert_printer(output, _Typename.str(), bit, dim);
+            unhilbert_printer(output, _Typename.str(), bit, dim);
+        }
+    }
+
+    output << "} // End of namespace tools" << std::endl;
+    output << std::endl << std::endl;
 
 }
 
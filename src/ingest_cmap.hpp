@@ -0,0 +1,198 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <array>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <type_traits>
+
+#include "cmap.hpp"
+
+
+namespace tools {
+
+
+/*
+    ingest_cmap<_Tc, _DIM, _Td>: cmap fed by many producer threads through a bounded lock-free ring
+        * producers claim a slot by advancing _enqueue, and publish the record by setting the sequence of the slot (as Vyukov's bounded queue)
+        * a single owner thread drains the ring in batches of at most _max_batch records, and passes them to the batch insert of cmap
+        * _inserted counts the records which are in the map, so flush() waits until it reaches the records claimed before the call
+        * the map is only touched by the owner thread, and by visit(f) under _lock
+*/
+template<class _Tc, size_t _DIM, class _Td>
+class ingest_cmap {
+
+    public:
+
+        typedef std::array<_Tc, _DIM>    coord_t;
+        typedef std::pair<coord_t, _Td>  pair_t;
+
+    private:
+
+        struct slot_t
+            {
+                std::atomic<size_t>                                                 _sequence;
+                typename std::aligned_storage<sizeof(pair_t), alignof(pair_t)>::type _record;
+            };
+
+        const size_t                    _mask;
+        const size_t                    _max_batch;
+        std::unique_ptr<slot_t[]>       _slots;
+        alignas(64) std::atomic<size_t> _enqueue;
+        alignas(64) std::atomic<size_t> _inserted;
+        alignas(64) size_t              _dequeue;
+        std::atomic<bool>               _stop;
+        std::mutex                      _lock;
+        cmap<_Tc, _DIM, _Td>            _map;
+        std::thread                     _owner;
+
+        static inline size_t _round(const size_t capacity) noexcept
+        {
+            size_t result = 1U;
+            while (result < capacity)
+                result <<= 1U;
+            return result;
+        }
+
+        // Move the record at _dequeue into batch, if it was published
+        inline bool _pop(std::vector<pair_t>& batch)
+        {
+            slot_t& slot = _slots[_dequeue & _mask];
+            if (slot._sequence.load(std::memory_order_acquire) != _dequeue + 1U)
+                return false;
+            pair_t * record = reinterpret_cast<pair_t *>(&slot._record);
+            batch.push_back(std::move(*record));
+            record->~pair_t();
+            slot._sequence.store(_dequeue + _mask + 1U, std::memory_order_release);
+            ++_dequeue;
+            return true;
+        }
+
+        // Drain the ring until stopped and empty, sleeping up to a millisecond when idle
+        inline void _drain()
+        {
+            std::vector<pair_t> batch;
+            batch.reserve(_max_batch);
+            uint32_t idle = 0U;
+            while (true)
+            {
+                while ((batch.size() < _max_batch) && _pop(batch)) {}
+                if (!batch.empty())
+                {
+                    const size_t number = batch.size();
+                    {
+                        std::lock_guard<std::mutex> guard(_lock);
+                        _map.insert(batch);
+                    }
+                    batch.clear();
+                    _inserted.fetch_add(number, std::memory_order_release);
+                    idle = 0U;
+                }
+                else if (_stop.load(std::memory_order_acquire) && (_dequeue == _enqueue.load(std::memory_order_acquire)))
+                    return;
+                else
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(1U << idle));
+                    idle += (idle < 10U) ? 1U : 0U;
+                }
+            }
+        }
+
+    public:
+
+        // capacity is rounded up to a power of two
+        ingest_cmap(const size_t capacity = 65536U, const size_t max_batch = 16384U) :
+            _mask(_round(capacity) - 1U), _max_batch(max_batch), _slots(new slot_t[_round(capacity)]),
+            _enqueue(0U), _inserted(0U), _dequeue(0U), _stop(false)
+        {
+            assert(max_batch > 0U);
+            for (size_t idx = 0U; idx <= _mask; ++idx)
+                _slots[idx]._sequence.store(idx, std::memory_order_relaxed);
+            _owner = std::thread(&ingest_cmap::_drain, this);
+        }
+
+        ~ingest_cmap()
+        {
+            _stop.store(true, std::memory_order_release);
+            _owner.join();
+        }
+
+        ingest_cmap(const ingest_cmap&) = delete;
+        ingest_cmap(ingest_cmap&&) = delete;
+        ingest_cmap& operator=(const ingest_cmap&) = delete;
+        ingest_cmap& operator=(ingest_cmap&&) = delete;
+
+        // Enqueue a record without blocking, and return false if the ring is full
+        inline bool try_insert(const coord_t& coord, const _Td& data)
+        {
+            size_t pos = _enqueue.load(std::memory_order_relaxed);
+            while (true)
+            {
+                slot_t& slot = _slots[pos & _mask];
+                const size_t sequence = slot._sequence.load(std::memory_order_acquire);
+                if (sequence == pos)
+                {
+                    if (_enqueue.compare_exchange_weak(pos, pos + 1U, std::memory_order_relaxed))
+                    {
+                        new (&slot._record) pair_t(coord, data);
+                        slot._sequence.store(pos + 1U, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (sequence < pos)
+                    return false; // The slot still holds the record of the previous lap
+                else
+                    pos = _enqueue.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Enqueue a record, yielding while the ring is full (backpressure)
+        inline void insert(const coord_t& coord, const _Td& data)
+        {
+            while (!try_insert(coord, data))
+                std::this_thread::yield();
+        }
+
+        // Wait until the records enqueued before the call are in the map
+        inline void flush() const
+        {
+            const size_t target = _enqueue.load(std::memory_order_acquire);
+            while (_inserted.load(std::memory_order_acquire) < target)
+                std::this_thread::yield();
+        }
+
+        // Number of records enqueued but not yet in the map
+        inline size_t pending() const
+        {
+            return _enqueue.load(std::memory_order_acquire) - _inserted.load(std::memory_order_acquire);
+        }
+
+        // Call f(map) while the owner thread does not insert
+        template<class _Tf>
+        inline void visit(_Tf f)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            f(_map);
+        }
+
+};
+
+
+} // End of namespace tools
+
+
@@ -0,0 +1,146 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <array>
+#include <vector>
+#include <cmath>
+
+#include "cmap.hpp"
+
+
+namespace tools {
+
+
+/*
+    quantized_cmap<_Tc, _DIM, _Td>: cmap fed with floating-point points
+        * a point x lies in cell floor((x - _origin) / _cell) >> num_resizes()
+        * points outside [0, 2^(8 * sizeof(_Tc))) cells are rejected, as are NaNs
+        * batches are converted in two passes over flat arrays (scale and check, then gather), so that the first pass vectorizes,
+          and are fed to the batch insert of cmap
+*/
+template<class _Tc, size_t _DIM, class _Td>
+class quantized_cmap {
+
+    public:
+
+        typedef std::array<_Tc, _DIM>     coord_t;
+        typedef std::array<double, _DIM>  point_t;
+        typedef std::pair<coord_t, _Td>   pair_t;
+
+    private:
+
+        point_t                 _origin;
+        double                  _cell;
+        double                  _inverse;
+        cmap<_Tc, _DIM, _Td>    _map;
+
+        // Number of cells along each dimension, as double
+        static inline double _limit() noexcept { return std::ldexp(1.0, 8U * sizeof(_Tc)); }
+
+    public:
+
+        quantized_cmap(const point_t& origin, const double cell) : _origin(origin), _cell(cell), _inverse(1.0 / cell)
+        {
+            assert(cell > 0.0);
+        }
+
+        ~quantized_cmap() {}
+
+        quantized_cmap(const quantized_cmap&) = delete;
+        quantized_cmap(quantized_cmap&&) = delete;
+        quantized_cmap& operator=(const quantized_cmap&) = delete;
+        quantized_cmap& operator=(quantized_cmap&&) = delete;
+
+        // Set coord to the (resized) cell of point, and return whether point lies inside the grid
+        inline bool quantize(const point_t& point, coord_t& coord) const
+        {
+            bool inside = true;
+            for (size_t dim = 0U; dim < _DIM; ++dim)
+            {
+                const double scaled = (point[dim] - _origin[dim]) * _inverse;
+                inside = inside && (scaled >= 0.0) && (scaled < _limit());
+                coord[dim] = inside ? (static_cast<_Tc>(scaled) >> _map.num_resizes()) : 0U;
+            }
+            return inside;
+        }
+
+        // Return the center of a (resized) cell
+        inline point_t center(const coord_t& coord) const
+        {
+            const double size = std::ldexp(_cell, _map.num_resizes());
+            point_t point;
+            for (size_t dim = 0U; dim < _DIM; ++dim)
+                point[dim] = _origin[dim] + (static_cast<double>(coord[dim]) + 0.5) * size;
+            return point;
+        }
+
+        inline bool insert(const point_t& point, const _Td& data)
+        {
+            coord_t coord;
+            if (!quantize(point, coord))
+                return false;
+            _map.insert(coord, data);
+            return true;
+        }
+
+        // Insert number points (points[_DIM * idx + dim]) with data[idx], and return the number of rejected points
+        inline size_t insert(const double * points, const _Td * data, const size_t number)
+        {
+            const double limit  = _limit();
+            const uint8_t shift = _map.num_resizes();
+            std::vector<double>  scaled(_DIM * number);
+            std::vector<uint8_t> inside(number);
+            #pragma omp simd
+            for (size_t idx = 0U; idx < number; ++idx)
+            {
+                uint8_t valid = 1U;
+                for (size_t dim = 0U; dim < _DIM; ++dim)
+                {
+                    const double value = (points[_DIM * idx + dim] - _origin[dim]) * _inverse;
+                    valid &= static_cast<uint8_t>((value >= 0.0) & (value < limit));
+                    scaled[_DIM * idx + dim] = value;
+                }
+                inside[idx] = valid;
+            }
+
+            std::vector<pair_t> batch;
+            batch.reserve(number);
+            for (size_t idx = 0U; idx < number; ++idx)
+            {
+                if (!inside[idx])
+                    continue;
+                coord_t coord;
+                for (size_t dim = 0U; dim < _DIM; ++dim)
+                    coord[dim] = static_cast<_Tc>(scaled[_DIM * idx + dim]) >> shift;
+                batch.push_back({ coord, data[idx] });
+            }
+            const size_t num_rejected = number - batch.size();
+            _map.insert(batch);
+            return num_rejected;
+        }
+
+        inline const point_t& origin() const { return _origin; }
+
+        inline double cell() const { return _cell; }
+
+        inline cmap<_Tc, _DIM, _Td>& map() { return _map; }
+
+        inline const cmap<_Tc, _DIM, _Td>& map() const { return _map; }
+
+};
+
+
+} // End of namespace tools
+
+
@@ -0,0 +1,163 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <array>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <type_traits>
+
+#include "cmap.hpp"
+
+
+namespace tools {
+
+
+namespace { namespace _cmapbase {
+
+
+/*
+    Header of a shard file, followed by the items of the shard in Morton order
+*/
+struct shard_header_t
+    {
+        char     _magic[8];
+        uint32_t _coord_bytes;
+        uint32_t _dim;
+        uint32_t _data_bytes;
+        uint32_t _num_resizes;
+        uint64_t _count;
+    };
+
+
+/*
+    Return the number of tree levels whose Morton prefix distinguishes num_shards shards (at most num_levels)
+*/
+inline uint8_t _shard_levels(const size_t DIM, const size_t num_shards, const size_t num_levels) noexcept
+    {
+        uint8_t levels = 0U;
+        while ((levels < num_levels) && (DIM * levels < 64U) && ((1ULL << (DIM * levels)) < num_shards))
+            ++levels;
+        return levels;
+    }
+
+
+} } // End of namespaces _cmapbase and {anonymous}
+
+
+/*
+    Return the shard (in [0, num_shards)) of a coordinate of a cmap with num_resizes resizes
+        * the shards are contiguous ranges of the Morton prefix of the top tree levels, so they are disjoint and ordered as the iteration
+        * the prefix consists of the child indices _bits on the path from the root, as the leading bits of tools::permute
+*/
+template<class _Tc, size_t _DIM>
+inline size_t shard_of(const std::array<_Tc, _DIM>& coord, const size_t num_shards, const uint8_t num_resizes = 0U)
+    {
+        assert(num_shards > 0U);
+        const uint8_t root_level = 8U * sizeof(_Tc) - 1U - num_resizes;
+        const uint8_t levels = _cmapbase::_shard_levels(_DIM, num_shards, root_level + 1U);
+        uint64_t prefix = 0U;
+        for (uint8_t level = 0U; level < levels; ++level)
+            prefix = (prefix << _DIM) | _cmapbase::_bits(coord, root_level - level);
+        return static_cast<size_t>((static_cast<unsigned __int128>(prefix) * num_shards) >> (_DIM * levels));
+    }
+
+
+/*
+    Write the items of a cmap (a shard) to a file, in Morton order; returns whether the file was written
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline bool write_shard(const cmap<_Tc, _DIM, _Td>& map, const std::string& filename)
+    {
+        static_assert(std::is_trivially_copyable<_Td>::value, "shard files require a trivially copyable _Td");
+        typedef typename cmap<_Tc, _DIM, _Td>::pair_t pair_t;
+        // The iteration visits the leafs in Morton order, so only the items within each leaf are sorted
+        auto less = [](const pair_t& left, const pair_t& right){ return _cmapbase::_morton_less(left.first, right.first); };
+        std::vector<pair_t> items;
+        items.reserve(map.size());
+        size_t first = 0U;
+        const void * leaf = nullptr;
+        for (auto iter = map.cbegin(); iter != map.cend(); ++iter)
+        {
+            if (iter.node() != leaf)
+            {
+                std::sort(items.begin() + first, items.end(), less);
+                first = items.size();
+                leaf  = iter.node();
+            }
+            items.push_back(*iter);
+        }
+        std::sort(items.begin() + first, items.end(), less);
+
+        const _cmapbase::shard_header_t header = { { 'c', 'm', 'a', 'p', 's', 'h', 'r', 'd' },
+            sizeof(_Tc), _DIM, sizeof(_Td), map.num_resizes(), items.size() };
+        std::ofstream output(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const auto& item : items)
+        {
+            output.write(reinterpret_cast<const char *>(item.first.data()), sizeof(item.first));
+            output.write(reinterpret_cast<const char *>(&(item.second)), sizeof(_Td));
+        }
+        return static_cast<bool>(output);
+    }
+
+
+/*
+    Replace the content of target by the union of disjoint shard files, given in Morton order (as the shards of shard_of)
+        * the items of the files are concatenated, and the tree is built from them at once, without inserting or merging
+        * returns false (and leaves target unchanged) if a file can not be read, does not match the cmap type,
+          the number of resizes differs between the files, or the items are not in strictly increasing Morton order
+          (within a file, or across the files as given)
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline bool merge_shards(const std::vector<std::string>& filenames, cmap<_Tc, _DIM, _Td>& target)
+    {
+        static_assert(std::is_trivially_copyable<_Td>::value, "shard files require a trivially copyable _Td");
+        typedef typename cmap<_Tc, _DIM, _Td>::pair_t pair_t;
+        std::vector<pair_t> data;
+        uint32_t num_resizes = 0U;
+        for (size_t idx = 0U; idx < filenames.size(); ++idx)
+        {
+            std::ifstream input(filenames[idx], std::ios::in | std::ios::binary);
+            _cmapbase::shard_header_t header;
+            if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)))
+                return false;
+            if ((std::string(header._magic, 8U) != "cmapshrd") || (header._coord_bytes != sizeof(_Tc)) || (header._dim != _DIM) || (header._data_bytes != sizeof(_Td)))
+                return false;
+            if ((idx != 0U) && (header._num_resizes != num_resizes))
+                return false;
+            num_resizes = header._num_resizes;
+
+            data.reserve(data.size() + header._count);
+            for (uint64_t count = 0U; count < header._count; ++count)
+            {
+                std::array<_Tc, _DIM> coord;
+                typename std::aligned_storage<sizeof(_Td), alignof(_Td)>::type value;
+                if (!input.read(reinterpret_cast<char *>(coord.data()), sizeof(coord)) || !input.read(reinterpret_cast<char *>(&value), sizeof(_Td)))
+                    return false;
+                // Within and across the files, every coordinate must follow the previous one in Morton order
+                if (!data.empty() && !_cmapbase::_morton_less(data.back().first, coord))
+                    return false;
+                data.emplace_back(coord, *reinterpret_cast<const _Td *>(&value));
+            }
+        }
+        target.assign(data, static_cast<uint8_t>(num_resizes));
+        return true;
+    }
+
+
+} // End of namespace tools
+
+
@@ -0,0 +1,252 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <array>
+#include <vector>
+#include <string>
+#include <memory>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cmap.hpp"
+#include "static_cmap.hpp"
+
+
+namespace tools {
+
+
+namespace { namespace _cmapbase {
+
+
+/*
+    Header of a shared segment, followed by the arrays of the image at offsets (in bytes) from the start of the segment
+        * the arrays are, in order, the words and ranks of _internal, the words and ranks of _shape, _first, _count and _entries
+*/
+struct segment_header_t
+    {
+        char     _magic[8];
+        uint32_t _coord_bytes;
+        uint32_t _dim;
+        uint32_t _data_bytes;
+        uint32_t _pair_bytes;
+        uint8_t  _num_resizes;
+        uint8_t  _root_level;
+        uint64_t _bytes;
+        uint64_t _offsets[7];
+        uint64_t _lengths[7];
+    };
+
+
+/*
+    Return offset rounded up to a cache line
+*/
+constexpr size_t _align(const size_t offset) noexcept
+    {
+        return (offset + 63U) & ~static_cast<size_t>(63U);
+    }
+
+
+} } // End of namespaces _cmapbase and {anonymous}
+
+
+/*
+    shared_cmap<_Tc, _DIM, _Td>: static_cmap image in a POSIX shared-memory segment, which other processes attach to
+        * the writer freezes a cmap and copies the arrays of the image into the segment, after a header with their offsets
+        * readers map the segment read-only, and query it in place: the image holds offsets instead of pointers,
+          so the segment may be mapped at a different address in every process
+        * the segment outlives the processes until unlink(name)
+        * _Tc and _Td must be trivially copyable, and all processes must use the same build of the types
+*/
+template<class _Tc, size_t _DIM, class _Td>
+class shared_cmap {
+
+    public:
+
+        typedef std::array<_Tc, _DIM>   coord_t;
+        typedef std::pair<coord_t, _Td> pair_t;
+        typedef const pair_t *          const_iterator;
+
+    private:
+
+        static_assert(std::is_trivially_copyable<_Tc>::value && std::is_trivially_copyable<_Td>::value, "shared_cmap requires trivially copyable types");
+
+        const uint8_t *                     _base;
+        size_t                              _bytes;
+        uint8_t                             _num_resizes;
+        _cmapbase::image_t<_Tc, _DIM, _Td>  _view;
+
+        static constexpr size_t _sizes[7] = { sizeof(uint64_t), sizeof(uint32_t), sizeof(uint64_t), sizeof(uint32_t), sizeof(size_t), sizeof(uint16_t), sizeof(pair_t) };
+
+        template<class _Tx>
+        inline const _Tx * _array(const _cmapbase::segment_header_t& header, const size_t idx) const noexcept
+        {
+            return reinterpret_cast<const _Tx *>(_base + header._offsets[idx]);
+        }
+
+        // Map bytes of the segment behind fd with protection, and set up the view if the header matches the types
+        inline bool _attach(const int fd, const size_t bytes, const int protection)
+        {
+            if (bytes < sizeof(_cmapbase::segment_header_t))
+                return false;
+            void * address = mmap(nullptr, bytes, protection, MAP_SHARED, fd, 0);
+            if (address == MAP_FAILED)
+                return false;
+            _base  = static_cast<const uint8_t *>(address);
+            _bytes = bytes;
+
+            const _cmapbase::segment_header_t& header = *reinterpret_cast<const _cmapbase::segment_header_t *>(_base);
+            bool valid = (std::string(header._magic, 8U) == "cmapshmm") && (header._coord_bytes == sizeof(_Tc)) && (header._dim == _DIM)
+                      && (header._data_bytes == sizeof(_Td)) && (header._pair_bytes == sizeof(pair_t)) && (header._bytes == bytes);
+            for (size_t idx = 0U; valid && (idx < 7U); ++idx)
+                valid = (header._offsets[idx] % 64U == 0U) && (header._offsets[idx] + header._lengths[idx] * _sizes[idx] <= bytes);
+            if (!valid)
+            {
+                munmap(address, bytes);
+                _base  = nullptr;
+                _bytes = 0U;
+                return false;
+            }
+            _num_resizes = header._num_resizes;
+            _view = { header._root_level,
+                      { _array<uint64_t>(header, 0U), _array<uint32_t>(header, 1U) },
+                      { _array<uint64_t>(header, 2U), _array<uint32_t>(header, 3U) },
+                      _array<size_t>(header, 4U), _array<uint16_t>(header, 5U), header._lengths[4],
+                      _array<pair_t>(header, 6U), header._lengths[6] };
+            return true;
+        }
+
+        template<class _Tx>
+        static inline void _place(uint8_t * base, _cmapbase::segment_header_t& header, size_t& offset, const size_t idx, const std::vector<_Tx>& array)
+        {
+            header._offsets[idx] = offset;
+            header._lengths[idx] = array.size();
+            std::uninitialized_copy(array.begin(), array.end(), reinterpret_cast<_Tx *>(base + offset));
+            offset = _cmapbase::_align(offset + sizeof(_Tx) * array.size());
+        }
+
+    public:
+
+        // Writer: create the segment name (as "/name") with the image of source; not valid() if the segment exists or can not be created
+        shared_cmap(const std::string& name, const cmap<_Tc, _DIM, _Td>& source) : _base(nullptr), _bytes(0U), _num_resizes(0U), _view()
+        {
+            const static_cmap<_Tc, _DIM, _Td> image(source);
+            const size_t lengths[7] = { image._internal._words.size(), image._internal._ranks.size(), image._shape._words.size(),
+                                        image._shape._ranks.size(), image._first.size(), image._count.size(), image._entries.size() };
+            size_t bytes = _cmapbase::_align(sizeof(_cmapbase::segment_header_t));
+            for (size_t idx = 0U; idx < 7U; ++idx)
+                bytes = _cmapbase::_align(bytes + lengths[idx] * _sizes[idx]);
+
+            const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+            if (fd < 0)
+                return;
+            void * address = (ftruncate(fd, bytes) == 0) ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+            if (address == MAP_FAILED)
+            {
+                close(fd);
+                shm_unlink(name.c_str());
+                return;
+            }
+
+            uint8_t * base = static_cast<uint8_t *>(address);
+            _cmapbase::segment_header_t header = { { 'c', 'm', 'a', 'p', 's', 'h', 'm', 'm' }, sizeof(_Tc), _DIM, sizeof(_Td), sizeof(pair_t),
+                                                   image._num_resizes, image._root_level, bytes, {}, {} };
+            size_t offset = _cmapbase::_align(sizeof(_cmapbase::segment_header_t));
+            _place(base, header, offset, 0U, image._internal._words);
+            _place(base, header, offset, 1U, image._internal._ranks);
+            _place(base, header, offset, 2U, image._shape._words);
+            _place(base, header, offset, 3U, image._shape._ranks);
+            _place(base, header, offset, 4U, image._first);
+            _place(base, header, offset, 5U, image._count);
+            _place(base, header, offset, 6U, image._entries);
+            assert(offset == bytes);
+            *reinterpret_cast<_cmapbase::segment_header_t *>(base) = header;
+            munmap(address, bytes);
+
+            // The writer queries the segment as the readers do
+            if (!_attach(fd, bytes, PROT_READ))
+                shm_unlink(name.c_str());
+            close(fd);
+        }
+
+        // Reader: map the segment name read-only; not valid() if it does not exist or does not hold an image of these types
+        explicit shared_cmap(const std::string& name) : _base(nullptr), _bytes(0U), _num_resizes(0U), _view()
+        {
+            const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0)
+                return;
+            struct stat status;
+            if (fstat(fd, &status) == 0)
+                _attach(fd, static_cast<size_t>(status.st_size), PROT_READ);
+            close(fd);
+        }
+
+        ~shared_cmap()
+        {
+            if (_base)
+                munmap(const_cast<uint8_t *>(_base), _bytes);
+        }
+
+        shared_cmap(const shared_cmap&) = delete;
+        shared_cmap(shared_cmap&&) = delete;
+        shared_cmap& operator=(const shared_cmap&) = delete;
+        shared_cmap& operator=(shared_cmap&&) = delete;
+
+        // Remove the segment name; mappings of attached processes remain valid
+        static inline bool unlink(const std::string& name) { return shm_unlink(name.c_str()) == 0; }
+
+        inline bool valid() const { return _base != nullptr; }
+
+        inline uint8_t num_resizes() const { return _num_resizes; }
+
+        inline size_t size() const { return _view._num_entries; }
+
+        inline bool empty() const { return _view._num_entries == 0U; }
+
+        inline const_iterator begin() const noexcept { return _view._entries; }
+        inline const_iterator   end() const noexcept { return _view._entries + _view._num_entries; }
+
+        inline const_iterator find(const coord_t& coord) const
+        {
+            assert(valid());
+            return _cmapbase::_image_find(_view, coord);
+        }
+
+        inline bool contains(const coord_t& coord) const { return find(coord) != end(); }
+
+        template<class _Tf>
+        inline void box(const coord_t& lower, const coord_t& upper, _Tf f) const
+        {
+            assert(valid());
+            coord_t corner;
+            corner.fill(0U);
+            _cmapbase::_image_box(_view, 0U, corner, _view._root_level, lower, upper, f);
+        }
+
+        // Bytes of the segment
+        inline size_t memory() const { return _bytes; }
+
+};
+
+
+template<class _Tc, size_t _DIM, class _Td>
+constexpr size_t shared_cmap<_Tc, _DIM, _Td>::_sizes[7];
+
+
+} // End of namespace tools
+
+
@@ -0,0 +1,212 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <array>
+#include <vector>
+#include <algorithm>
+
+#include "cmap.hpp"
+
+
+namespace tools {
+
+
+namespace { namespace _cmapbase {
+
+
+/*
+    Mix the Morton key of coordinates into 64 bits, folding it in chunks of whole levels
+*/
+template<class _Tc, size_t _DIM>
+inline uint64_t _morton_hash(const std::array<_Tc, _DIM>& coordinates) noexcept
+    {
+        uint64_t result = 0x9e3779b97f4a7c15ULL;
+        uint64_t chunk  = 0U;
+        size_t   used   = 0U;
+        for (size_t level = 8U * sizeof(_Tc); level-- > 0U;)
+        {
+            chunk = (chunk << _DIM) | _bits(coordinates, static_cast<uint8_t>(level));
+            used += _DIM;
+            if ((used + _DIM > 64U) || (level == 0U))
+            {
+                result ^= chunk;
+                result *= 0xbf58476d1ce4e5b9ULL;
+                result ^= result >> 31U;
+                chunk = 0U;
+                used  = 0U;
+            }
+        }
+        result *= 0x94d049bb133111ebULL;
+        return result ^ (result >> 29U);
+    }
+
+
+} } // End of namespaces _cmapbase and {anonymous}
+
+
+/*
+    sketch_cmap<_Tc, _DIM>: counts per cell in at most _max_entries exact cmap entries, with a Count-Min sketch for the long tail
+        * a cell is counted exactly while it has an entry; cells without one are counted in the _depth x _width sketch,
+          whose row r is indexed with h1 + r * h2 of the hash of the Morton key of the cell
+        * when the map is full and a sketched cell reaches _threshold, the lighter half of the entries is spilled into the sketch
+          (and _threshold rises to the heaviest spilled count), after which the cell gets an entry
+        * a cell which gets an entry after spills carries its estimate along in _carried, so its count is only exact if _carried is 0
+        * estimates never underestimate, and memory is bounded by _max_entries entries and _depth x _width counters
+*/
+template<class _Tc, size_t _DIM>
+class sketch_cmap {
+
+    public:
+
+        typedef std::array<_Tc, _DIM> coord_t;
+
+        struct count_t
+            {
+                uint64_t _count;
+                uint64_t _carried;
+
+                friend inline void merge(count_t& left, const count_t& right)
+                {
+                    left._count   += right._count;
+                    left._carried += right._carried;
+                }
+            };
+
+    private:
+
+        const size_t                _max_entries;
+        const size_t                _width;
+        const size_t                _depth;
+        std::vector<uint64_t>       _counters;
+        uint64_t                    _threshold;
+        uint64_t                    _total;
+        cmap<_Tc, _DIM, count_t>    _map;
+
+        static inline size_t _round(const size_t width) noexcept
+        {
+            size_t result = 1U;
+            while (result < width)
+                result <<= 1U;
+            return result;
+        }
+
+        template<class _Tf>
+        inline void _rows(const coord_t& coord, _Tf f) const
+        {
+            const uint64_t hash = _cmapbase::_morton_hash(coord);
+            const uint64_t step = (hash >> 32U) | 1U;
+            for (size_t row = 0U; row < _depth; ++row)
+                f(row * _width + (((hash & 0xffffffffULL) + row * step) & (_width - 1U)));
+        }
+
+        inline void _add(const coord_t& coord, const uint64_t weight)
+        {
+            _rows(coord, [&](const size_t idx){ _counters[idx] += weight; });
+        }
+
+        // Minimum over the rows of the sketch, which never underestimates the sketched count of coord
+        inline uint64_t _estimate(const coord_t& coord) const
+        {
+            uint64_t result = ~0ULL;
+            _rows(coord, [&](const size_t idx){ result = std::min(result, _counters[idx]); });
+            return result;
+        }
+
+        // Move the entries up to the median count into the sketch
+        inline void _spill()
+        {
+            std::vector<uint64_t> counts;
+            counts.reserve(_map.size());
+            for (const auto& item : _map)
+                counts.push_back(item.second._count);
+            auto median = counts.begin() + counts.size() / 2U;
+            std::nth_element(counts.begin(), median, counts.end());
+            _threshold = std::max(_threshold, *median);
+
+            std::vector<typename cmap<_Tc, _DIM, count_t>::pair_t> kept;
+            for (const auto& item : _map)
+            {
+                if (item.second._count > *median)
+                    kept.push_back(item);
+                else
+                    _add(item.first, item.second._count - item.second._carried);
+            }
+            _map.clear();
+            _map.insert(kept);
+        }
+
+    public:
+
+        // width is rounded up to a power of two
+        sketch_cmap(const size_t max_entries, const size_t width = 65536U, const size_t depth = 4U) :
+            _max_entries(max_entries), _width(_round(width)), _depth(depth), _counters(_round(width) * depth, 0U), _threshold(0U), _total(0U)
+        {
+            assert((max_entries > 0U) && (depth > 0U));
+        }
+
+        ~sketch_cmap() {}
+
+        sketch_cmap(const sketch_cmap&) = delete;
+        sketch_cmap(sketch_cmap&&) = delete;
+        sketch_cmap& operator=(const sketch_cmap&) = delete;
+        sketch_cmap& operator=(sketch_cmap&&) = delete;
+
+        inline void insert(const coord_t& coord, const uint64_t weight = 1U)
+        {
+            _total += weight;
+            auto iter = _map.find(coord);
+            if (iter != _map.end())
+            {
+                (*iter).second._count += weight;
+                return;
+            }
+            const uint64_t estimate = _estimate(coord);
+            if ((_map.size() >= _max_entries) && (estimate + weight < std::max<uint64_t>(_threshold, 1U)))
+            {
+                _add(coord, weight);
+                return;
+            }
+            if (_map.size() >= _max_entries)
+                _spill();
+            _map.insert(coord, { estimate + weight, estimate });
+        }
+
+        // Set count to the (estimated) count of coord, and return whether it is exact
+        inline bool find(const coord_t& coord, uint64_t& count) const
+        {
+            auto iter = _map.find(coord);
+            if (iter != _map.end())
+            {
+                count = (*iter).second._count;
+                return (*iter).second._carried == 0U;
+            }
+            count = _estimate(coord);
+            return count == 0U;
+        }
+
+        // Exactly counted cells
+        inline const cmap<_Tc, _DIM, count_t>& map() const { return _map; }
+
+        inline uint64_t threshold() const { return _threshold; }
+
+        inline uint64_t total() const { return _total; }
+
+        inline size_t memory() const { return sizeof(sketch_cmap) + sizeof(uint64_t) * _counters.size() + _map.memory(); }
+
+};
+
+
+} // End of namespace tools
+
+
@@ -0,0 +1,188 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <array>
+#include <vector>
+
+#include "cmap.hpp"
+
+
+namespace tools {
+
+
+/*
+    slab_cmap<_Tc, _DIM, _Td>: cmap whose leafs hold handles (32-bit indices) to slots in a slab of payloads
+        * _split, _resize, _prune and the set operations move 4 bytes per entry instead of a _Td
+        * the slab is a vector of chunks of _chunk slots, so slots stay put when it grows, and merge_union splices the chunks of other
+        * the map combines handles with _merge, which merges the payloads and pushes the slot of the right handle onto _free,
+          from which later insertions take their slots
+*/
+template<class _Tc, size_t _DIM, class _Td>
+class slab_cmap {
+
+    public:
+
+        typedef std::array<_Tc, _DIM> coord_t;
+
+    private:
+
+        struct handle_t
+            {
+                uint32_t _index;
+            };
+
+        static constexpr uint32_t _shift = 10U;
+        static constexpr uint32_t _chunk = 1U << _shift;
+
+        std::vector<std::vector<_Td>>   _chunks;
+        std::vector<uint32_t>           _free;
+        cmap<_Tc, _DIM, handle_t>       _map;
+
+        inline _Td& _at(const handle_t handle) { return _chunks[handle._index >> _shift][handle._index & (_chunk - 1U)]; }
+
+        inline const _Td& _at(const handle_t handle) const { return _chunks[handle._index >> _shift][handle._index & (_chunk - 1U)]; }
+
+        inline handle_t _allocate(const _Td& data)
+        {
+            if (!_free.empty())
+            {
+                const handle_t handle = { _free.back() };
+                _free.pop_back();
+                _at(handle) = data;
+                return handle;
+            }
+            if (_chunks.empty() || (_chunks.back().size() == _chunk))
+            {
+                assert(_chunks.size() < (1ULL << (32U - _shift)));
+                _chunks.emplace_back();
+                _chunks.back().reserve(_chunk); // Never reallocates afterwards
+            }
+            _chunks.back().push_back(data);
+            return { static_cast<uint32_t>(((_chunks.size() - 1U) << _shift) + _chunks.back().size() - 1U) };
+        }
+
+        inline void _merge(handle_t& left, const handle_t& right)
+        {
+            merge(_at(left), _at(right));
+            _free.push_back(right._index);
+        }
+
+        inline auto _combine()
+        {
+            return [this](handle_t& left, const handle_t& right){ _merge(left, right); };
+        }
+
+    public:
+
+        slab_cmap() {}
+
+        ~slab_cmap() {}
+
+        slab_cmap(const slab_cmap&) = delete;
+        slab_cmap(slab_cmap&&) = delete;
+        slab_cmap& operator=(const slab_cmap&) = delete;
+        slab_cmap& operator=(slab_cmap&&) = delete;
+
+        inline void insert(const coord_t& coord, const _Td& data) { _map.insert(coord, _allocate(data), _combine()); }
+
+        inline void resize() { _map.resize(_combine()); }
+
+        inline void merge_union(slab_cmap& other)
+        {
+            assert(&other != this);
+            if (other.empty())
+            {
+                other.clear();
+                return;
+            }
+            // Fill up the last chunk, so that the chunks of other can follow it
+            if (!_chunks.empty())
+            {
+                std::vector<_Td>& last = _chunks.back();
+                for (size_t slot = last.size(); slot < _chunk; ++slot)
+                    _free.push_back(static_cast<uint32_t>(((_chunks.size() - 1U) << _shift) + slot));
+                last.resize(_chunk);
+            }
+            assert(_chunks.size() + other._chunks.size() <= (1ULL << (32U - _shift)));
+            const uint32_t base = static_cast<uint32_t>(_chunks.size() << _shift);
+            for (auto& chunk : other._chunks)
+                _chunks.push_back(std::move(chunk));
+            for (const uint32_t index : other._free)
+                _free.push_back(base + index);
+            for (auto iter = other._map.begin(); iter != other._map.end(); ++iter)
+                (*iter).second._index += base;
+            _map.merge_union(other._map, _combine());
+            other.clear();
+        }
+
+        inline size_t erase(const coord_t& coord)
+        {
+            auto iter = _map.find(coord);
+            if (iter == _map.end())
+                return 0U;
+            _free.push_back((*iter).second._index);
+            return _map.erase(coord);
+        }
+
+        inline void clear()
+        {
+            _map.clear();
+            _chunks.clear();
+            _free.clear();
+        }
+
+        inline uint8_t num_resizes() const { return _map.num_resizes(); }
+
+        inline size_t size() const { return _map.size(); }
+
+        inline bool empty() const { return _map.empty(); }
+
+        inline bool contains(const coord_t& coord) const { return _map.contains(coord); }
+
+        inline const _Td * find(const coord_t& coord) const
+        {
+            auto iter = _map.find(coord);
+            return (iter == _map.end()) ? nullptr : &(_at((*iter).second));
+        }
+
+        inline _Td& operator[](const coord_t& coord)
+        {
+            auto iter = _map.find(coord);
+            if (iter == _map.end())
+            {
+                const handle_t handle = _allocate(_Td());
+                _map.insert(coord, handle, _combine());
+                return _at(handle);
+            }
+            return _at((*iter).second);
+        }
+
+        template<class _Tf>
+        inline void for_each(_Tf f)
+        {
+            for (auto iter = _map.cbegin(); iter != _map.cend(); ++iter)
+                f((*iter).first, _at((*iter).second));
+        }
+
+        // The number of slots in the slab, and how many of them were released (by merges and erase)
+        inline size_t slots() const { return _chunks.empty() ? 0U : ((_chunks.size() - 1U) << _shift) + _chunks.back().size(); }
+
+        inline size_t released() const { return _free.size(); }
+
+};
+
+
+} // End of namespace tools
+
+
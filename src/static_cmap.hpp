@@ -0,0 +1,315 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <array>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#include "cmap.hpp"
+
+
+namespace tools {
+
+
+template<class _Tc, size_t _DIM, class _Td> class shared_cmap;
+
+
+namespace { namespace _cmapbase {
+
+
+/*
+    bits_t: bit vector with a rank directory
+        * _words holds the bits, with bit p in _words[p / 64] at position p % 64
+        * _ranks[w] holds the number of set bits in _words[0, w)
+*/
+struct bits_t
+    {
+        std::vector<uint64_t> _words;
+        std::vector<uint32_t> _ranks;
+    };
+
+
+/*
+    Append a bit to a bit vector of size bits
+*/
+inline void _push(bits_t& vector, const size_t size, const bool bit)
+    {
+        if ((size & 63U) == 0U)
+            vector._words.push_back(0U);
+        if (bit)
+            vector._words.back() |= 1ULL << (size & 63U);
+    }
+
+
+/*
+    Build the rank directory of a bit vector
+*/
+inline void _rank_directory(bits_t& vector)
+    {
+        vector._ranks.resize(vector._words.size() + 1U);
+        vector._ranks[0] = 0U;
+        for (size_t idx = 0U; idx < vector._words.size(); ++idx)
+            vector._ranks[idx + 1U] = vector._ranks[idx] + __builtin_popcountll(vector._words[idx]);
+    }
+
+
+/*
+    bits_view_t: read-only view on the words and the rank directory of a bit vector, wherever they are stored
+*/
+struct bits_view_t
+    {
+        const uint64_t * _words;
+        const uint32_t * _ranks;
+    };
+
+
+/*
+    Return the view on a bit vector
+*/
+inline bits_view_t _view(const bits_t& vector) noexcept
+    {
+        return { vector._words.data(), vector._ranks.data() };
+    }
+
+
+/*
+    Return whether bit pos of a bit vector is set
+*/
+inline bool _get(const bits_view_t& vector, const size_t pos) noexcept
+    {
+        return (vector._words[pos >> 6U] >> (pos & 63U)) & 1U;
+    }
+
+
+/*
+    Return the number of set bits in [0, pos) of a bit vector (pos within the bit vector)
+*/
+inline size_t _rank(const bits_view_t& vector, const size_t pos) noexcept
+    {
+        return vector._ranks[pos >> 6U] + __builtin_popcountll(vector._words[pos >> 6U] & ((1ULL << (pos & 63U)) - 1U));
+    }
+
+
+/*
+    image_t: read-only view on the arrays of a static_cmap (see below), wherever they are stored
+*/
+template<class _Tc, size_t _DIM, class _Td>
+struct image_t
+    {
+        uint8_t                                        _root_level;
+        bits_view_t                                    _internal;
+        bits_view_t                                    _shape;
+        const size_t *                                 _first;
+        const uint16_t *                               _count;
+        size_t                                         _num_leafs;
+        const std::pair<std::array<_Tc, _DIM>, _Td> * _entries;
+        size_t                                         _num_entries;
+    };
+
+
+/*
+    Return the entry of an image with coordinate coord, or image._entries + image._num_entries
+*/
+template<class _Tc, size_t _DIM, class _Td>
+inline const std::pair<std::array<_Tc, _DIM>, _Td> * _image_find(const image_t<_Tc, _DIM, _Td>& image, const std::array<_Tc, _DIM>& coord)
+    {
+        const auto * end = image._entries + image._num_entries;
+        size_t node = 0U;
+        for (uint8_t level = image._root_level; _get(image._internal, node); --level)
+        {
+            const size_t pos = (_rank(image._internal, node) << _DIM) + _bits(coord, level);
+            if (!_get(image._shape, pos))
+                return end;
+            node = _rank(image._shape, pos) + 1U;
+        }
+        const size_t leaf = node - _rank(image._internal, node);
+        if (leaf == image._num_leafs)
+            return end;
+        const auto * first = image._entries + image._first[leaf];
+        const auto * found = std::find_if(first, first + image._count[leaf], [&](const std::pair<std::array<_Tc, _DIM>, _Td>& item){ return _equal(item.first, coord); });
+        return (found == first + image._count[leaf]) ? end : found;
+    }
+
+
+/*
+    Call f(item) for the items of node (with lower corner and level) of an image inside [lower, upper]
+*/
+template<class _Tc, size_t _DIM, class _Td, class _Tf>
+inline void _image_box(const image_t<_Tc, _DIM, _Td>& image, const size_t node, const std::array<_Tc, _DIM>& corner, const uint8_t level,
+                       const std::array<_Tc, _DIM>& lower, const std::array<_Tc, _DIM>& upper, _Tf& f)
+    {
+        if (!_get(image._internal, node))
+        {
+            const size_t leaf = node - _rank(image._internal, node);
+            for (size_t idx = image._first[leaf]; idx < image._first[leaf] + image._count[leaf]; ++idx)
+            {
+                bool inside = true;
+                for (size_t dim = 0U; dim < _DIM; ++dim)
+                    inside = inside && (lower[dim] <= image._entries[idx].first[dim]) && (image._entries[idx].first[dim] <= upper[dim]);
+                if (inside)
+                    f(image._entries[idx]);
+            }
+            return;
+        }
+        const size_t row  = _rank(image._internal, node) << _DIM;
+        const _Tc    bit  = static_cast<_Tc>(1U) << level;
+        const _Tc    span = bit - 1U;
+        for (uint32_t idx = 0U; idx < (1U << _DIM); ++idx)
+        {
+            if (!_get(image._shape, row + idx))
+                continue;
+            std::array<_Tc, _DIM> child = corner;
+            bool overlap = true;
+            for (size_t dim = 0U; dim < _DIM; ++dim)
+            {
+                if ((idx >> (_DIM - 1U - dim)) & 1U)
+                    child[dim] |= bit;
+                overlap = overlap && (child[dim] <= upper[dim]) && (lower[dim] <= child[dim] + span);
+            }
+            if (overlap)
+                _image_box(image, _rank(image._shape, row + idx) + 1U, child, level - 1U, lower, upper, f);
+        }
+    }
+
+
+} } // End of namespaces _cmapbase and {anonymous}
+
+
+/*
+    static_cmap<_Tc, _DIM, _Td>: immutable, pointer-free image of a cmap
+        * the populated tree shape is stored level by level (breadth-first, as LOUDS):
+            - _internal has one bit per node, set if the node has children
+            - _shape has 2^DIM bits per node with children, set if the child is populated
+            - the k-th set bit of _shape (from 0) is node k + 1, so the child of a node follows from a rank
+        * the leafs refer to ranges of _entries, which are sorted in the iteration order of cmap
+*/
+template<class _Tc, size_t _DIM, class _Td>
+class static_cmap {
+
+    public:
+
+        typedef std::array<_Tc, _DIM>   coord_t;
+        typedef std::pair<coord_t, _Td> pair_t;
+        typedef typename std::vector<pair_t>::const_iterator const_iterator;
+
+    private:
+
+        uint8_t                 _num_resizes;
+        uint8_t                 _root_level;
+        _cmapbase::bits_t       _internal;
+        _cmapbase::bits_t       _shape;
+        std::vector<size_t>     _first;
+        std::vector<uint16_t>   _count;
+        std::vector<pair_t>     _entries;
+
+        struct _range_t
+            {
+                size_t  _first;
+                size_t  _last;
+                uint8_t _level;
+            };
+
+        inline _cmapbase::image_t<_Tc, _DIM, _Td> _image() const noexcept
+        {
+            return { _root_level, _cmapbase::_view(_internal), _cmapbase::_view(_shape), _first.data(), _count.data(), _first.size(), _entries.data(), _entries.size() };
+        }
+
+        template<class, size_t, class> friend class shared_cmap;
+
+    public:
+
+        explicit static_cmap(const cmap<_Tc, _DIM, _Td>& source)
+        {
+            assert(source.num_resizes() < 8U * sizeof(_Tc));
+            _num_resizes = source.num_resizes();
+            _root_level  = 8U * sizeof(_Tc) - 1U - _num_resizes;
+            _entries.reserve(source.size());
+            for (const auto& item : source)
+                _entries.push_back(item);
+            std::sort(_entries.begin(), _entries.end(), [](const pair_t& left, const pair_t& right)
+                { return _cmapbase::_morton_less(left.first, right.first); });
+
+            // Breadth-first over the ranges of _entries, splitting as cmap does
+            size_t num_nodes = 0U;
+            size_t num_slots = 0U;
+            std::deque<_range_t> queue = { { 0U, _entries.size(), _root_level } };
+            while (!queue.empty())
+            {
+                const _range_t range = queue.front();
+                queue.pop_front();
+                const bool internal = range._last - range._first > (1U << _DIM);
+                _cmapbase::_push(_internal, num_nodes++, internal);
+                if (!internal)
+                {
+                    _first.push_back(range._first);
+                    _count.push_back(static_cast<uint16_t>(range._last - range._first));
+                    continue;
+                }
+                auto head = _entries.begin() + range._first;
+                for (uint32_t idx = 0U; idx < (1U << _DIM); ++idx)
+                {
+                    auto tail = std::partition_point(head, _entries.begin() + range._last, [&](const pair_t& item)
+                        { return _cmapbase::_bits(item.first, range._level) <= idx; });
+                    _cmapbase::_push(_shape, num_slots++, head != tail);
+                    if (head != tail)
+                        queue.push_back({ static_cast<size_t>(head - _entries.begin()), static_cast<size_t>(tail - _entries.begin()), static_cast<uint8_t>(range._level - 1U) });
+                    head = tail;
+                }
+            }
+            _cmapbase::_rank_directory(_internal);
+            _cmapbase::_rank_directory(_shape);
+        }
+
+        ~static_cmap() {}
+
+        inline uint8_t num_resizes() const { return _num_resizes; }
+
+        inline size_t size() const { return _entries.size(); }
+
+        inline bool empty() const { return _entries.empty(); }
+
+        inline const_iterator begin() const noexcept { return _entries.begin(); }
+        inline const_iterator   end() const noexcept { return _entries.end(); }
+
+        inline const_iterator find(const coord_t& coord) const
+        {
+            return _entries.begin() + (_cmapbase::_image_find(_image(), coord) - _entries.data());
+        }
+
+        inline bool contains(const coord_t& coord) const { return find(coord) != end(); }
+
+        template<class _Tf>
+        inline void box(const coord_t& lower, const coord_t& upper, _Tf f) const
+        {
+            coord_t corner;
+            corner.fill(0U);
+            _cmapbase::_image_box(_image(), 0U, corner, _root_level, lower, upper, f);
+        }
+
+        inline size_t memory() const
+        {
+            return sizeof(static_cmap)
+                 + sizeof(uint64_t) * (_internal._words.size() + _shape._words.size())
+                 + sizeof(uint32_t) * (_internal._ranks.size() + _shape._ranks.size())
+                 + (sizeof(size_t) + sizeof(uint16_t)) * _first.size()
+                 + sizeof(pair_t) * _entries.size();
+        }
+
+};
+
+
+} // End of namespace tools
+
+
@@ -0,0 +1,200 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <array>
+#include <type_traits>
+
+#include "cmap.hpp"
+
+
+namespace tools {
+
+
+namespace { namespace _cmapbase {
+
+
+/*
+    Number of dimension groups of a wide coordinate: 1, 2 or 4, such that each group has at most 8 dimensions
+*/
+constexpr size_t _num_groups(const size_t DIM) noexcept
+    {
+        return (DIM <= 8U) ? 1U : ((DIM <= 16U) ? 2U : 4U);
+    }
+
+
+/*
+    Unsigned integer type of num_bytes bytes
+*/
+template<size_t num_bytes>
+using uint_t = typename std::conditional<num_bytes == 1U, uint8_t,
+               typename std::conditional<num_bytes == 2U, uint16_t,
+               typename std::conditional<num_bytes == 4U, uint32_t, uint64_t>::type>::type>::type;
+
+
+/*
+    Spread the bits of value with magic masks, so that bit b moves to bit b * groups (groups = 1, 2 or 4)
+*/
+template<size_t groups>
+inline uint64_t _spread(uint64_t value) noexcept
+    {
+        if (groups == 2U)
+        {
+            value = (value | (value << 16U)) & 0x0000ffff0000ffffULL;
+            value = (value | (value <<  8U)) & 0x00ff00ff00ff00ffULL;
+            value = (value | (value <<  4U)) & 0x0f0f0f0f0f0f0f0fULL;
+            value = (value | (value <<  2U)) & 0x3333333333333333ULL;
+            value = (value | (value <<  1U)) & 0x5555555555555555ULL;
+        }
+        else if (groups == 4U)
+        {
+            value = (value | (value << 24U)) & 0x000000ff000000ffULL;
+            value = (value | (value << 12U)) & 0x000f000f000f000fULL;
+            value = (value | (value <<  6U)) & 0x0303030303030303ULL;
+            value = (value | (value <<  3U)) & 0x1111111111111111ULL;
+        }
+        return value;
+    }
+
+
+/*
+    Inverse of _spread: gather the bits b * groups of value into bit b
+*/
+template<size_t groups>
+inline uint64_t _squeeze(uint64_t value) noexcept
+    {
+        if (groups == 2U)
+        {
+            value &= 0x5555555555555555ULL;
+            value = (value | (value >>  1U)) & 0x3333333333333333ULL;
+            value = (value | (value >>  2U)) & 0x0f0f0f0f0f0f0f0fULL;
+            value = (value | (value >>  4U)) & 0x00ff00ff00ff00ffULL;
+            value = (value | (value >>  8U)) & 0x0000ffff0000ffffULL;
+            value = (value | (value >> 16U)) & 0x00000000ffffffffULL;
+        }
+        else if (groups == 4U)
+        {
+            value &= 0x1111111111111111ULL;
+            value = (value | (value >>  3U)) & 0x0303030303030303ULL;
+            value = (value | (value >>  6U)) & 0x000f000f000f000fULL;
+            value = (value | (value >> 12U)) & 0x000000ff000000ffULL;
+            value = (value | (value >> 24U)) & 0x000000000000ffffULL;
+        }
+        return value;
+    }
+
+
+} } // End of namespaces _cmapbase and {anonymous}
+
+
+/*
+    wide_cmap<_Tc, _DIM, _Td>: cmap for 8 < _DIM <= 32, with each tree level splitting on a group of at most 8 dimensions
+        * the _DIM dimensions are divided into _GROUPS groups of _WIDTH dimensions: dimension dim is slot dim / _WIDTH of dimension dim % _WIDTH
+        * bit b of slot s is bit b * _GROUPS + s of an interleaved coordinate of _GROUPS times the width of _Tc
+        * the interleaved coordinates are stored in a cmap<_wide_t, _WIDTH, _Td>, so that nodes have at most 256 children
+          and consecutive levels split on consecutive groups
+        * resize shifts the interleaved coordinates _GROUPS times, i.e. once for every dimension
+*/
+template<class _Tc, size_t _DIM, class _Td>
+class wide_cmap {
+
+    public:
+
+        typedef std::array<_Tc, _DIM> coord_t;
+
+    private:
+
+        static constexpr size_t _GROUPS = _cmapbase::_num_groups(_DIM);
+        static constexpr size_t _WIDTH  = (_DIM + _GROUPS - 1U) / _GROUPS;
+
+        static_assert(_DIM <= 32U, "wide_cmap supports up to 32 dimensions");
+        static_assert(_GROUPS * sizeof(_Tc) <= 8U, "interleaved coordinates must fit in 64 bits");
+
+        typedef _cmapbase::uint_t<_GROUPS * sizeof(_Tc)> _wide_t;
+        typedef std::array<_wide_t, _WIDTH>             _wide_coord_t;
+
+        cmap<_wide_t, _WIDTH, _Td> _map;
+
+        static inline _wide_coord_t _encode(const coord_t& coord) noexcept
+        {
+            _wide_coord_t wide;
+            wide.fill(0U);
+            for (size_t dim = 0U; dim < _DIM; ++dim)
+                wide[dim % _WIDTH] |= static_cast<_wide_t>(_cmapbase::_spread<_GROUPS>(coord[dim]) << (dim / _WIDTH));
+            return wide;
+        }
+
+        static inline coord_t _decode(const _wide_coord_t& wide) noexcept
+        {
+            coord_t coord;
+            for (size_t dim = 0U; dim < _DIM; ++dim)
+                coord[dim] = static_cast<_Tc>(_cmapbase::_squeeze<_GROUPS>(wide[dim % _WIDTH] >> (dim / _WIDTH)));
+            return coord;
+        }
+
+    public:
+
+        wide_cmap() {}
+
+        ~wide_cmap() {}
+
+        wide_cmap(const wide_cmap&) = delete;
+        wide_cmap(wide_cmap&&) = delete;
+        wide_cmap& operator=(const wide_cmap&) = delete;
+        wide_cmap& operator=(wide_cmap&&) = delete;
+
+        inline void insert(const coord_t& coord, const _Td& data) { _map.insert(_encode(coord), data); }
+
+        inline void resize()
+        {
+            for (size_t group = 0U; group < _GROUPS; ++group)
+                _map.resize();
+        }
+
+        inline void merge_union(wide_cmap& other) { _map.merge_union(other._map); }
+
+        inline size_t erase(const coord_t& coord) { return _map.erase(_encode(coord)); }
+
+        inline void clear() { _map.clear(); }
+
+        inline uint8_t num_resizes() const { return _map.num_resizes() / _GROUPS; }
+
+        inline size_t size() const { return _map.size(); }
+
+        inline bool empty() const { return _map.empty(); }
+
+        inline bool contains(const coord_t& coord) const { return _map.contains(_encode(coord)); }
+
+        inline const _Td * find(const coord_t& coord) const
+        {
+            auto iter = _map.find(_encode(coord));
+            return (iter == _map.end()) ? nullptr : &((*iter).second);
+        }
+
+        inline _Td& operator[](const coord_t& coord) { return _map[_encode(coord)]; }
+
+        template<class _Tf>
+        inline void for_each(_Tf f)
+        {
+            for (auto iter = _map.begin(); iter != _map.end(); ++iter)
+                f(_decode((*iter).first), (*iter).second);
+        }
+
+        inline size_t memory() const { return _map.memory(); }
+
+};
+
+
+} // End of namespace tools
+
+
@@ -0,0 +1,167 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#pragma once
+
+#include <assert.h>
+#include <array>
+#include <deque>
+#include <memory>
+
+#include "cmap.hpp"
+
+
+namespace tools {
+
+
+/*
+    window_cmap<_Tc, _DIM, _Td>: sliding window over the last _window epochs, with one cmap (generation) per epoch
+        * insertions go to the generation of the current epoch, and advance() starts the next one
+        * expiry drops the oldest generation as a whole, instead of erasing (and pruning) its entries one by one
+        * the generation which becomes _compact_age epochs old is resized _compact_resizes times and compacted,
+          so older epochs are kept at a coarser resolution in less memory
+        * queries take coordinates at the resolution of insert, and shift them for the generations which were resized
+*/
+template<class _Tc, size_t _DIM, class _Td>
+class window_cmap {
+
+    public:
+
+        typedef std::array<_Tc, _DIM> coord_t;
+        typedef cmap<_Tc, _DIM, _Td>  map_t;
+
+    private:
+
+        const size_t                        _window;
+        const size_t                        _compact_age;
+        const uint8_t                       _compact_resizes;
+        uint64_t                            _epoch;
+        std::deque<std::unique_ptr<map_t>>  _generations; // Oldest first
+
+        static inline coord_t _shift(const coord_t& coord, const uint8_t num_resizes) noexcept
+        {
+            coord_t shifted;
+            for (size_t dim = 0U; dim < _DIM; ++dim)
+                shifted[dim] = coord[dim] >> num_resizes;
+            return shifted;
+        }
+
+    public:
+
+        // compact_age = 0 never compacts
+        window_cmap(const size_t window, const size_t compact_age = 0U, const uint8_t compact_resizes = 1U) :
+            _window(window), _compact_age(compact_age), _compact_resizes(compact_resizes), _epoch(0U)
+        {
+            assert(window > 0U);
+            assert(compact_resizes < 8U * sizeof(_Tc));
+            _generations.emplace_back(new map_t());
+        }
+
+        ~window_cmap() {}
+
+        window_cmap(const window_cmap&) = delete;
+        window_cmap(window_cmap&&) = delete;
+        window_cmap& operator=(const window_cmap&) = delete;
+        window_cmap& operator=(window_cmap&&) = delete;
+
+        inline void insert(const coord_t& coord, const _Td& data) { _generations.back()->insert(coord, data); }
+
+        // Start the next epoch: expire the oldest generation if the window is full, and compact the one which became old
+        inline void advance()
+        {
+            ++_epoch;
+            if (_generations.size() == _window)
+                _generations.pop_front();
+            _generations.emplace_back(new map_t());
+            if ((_compact_age != 0U) && (_generations.size() > _compact_age))
+            {
+                map_t& old = *_generations[_generations.size() - 1U - _compact_age];
+                for (uint8_t count = 0U; count < _compact_resizes; ++count)
+                    old.resize();
+                old.compact();
+            }
+        }
+
+        inline uint64_t epoch() const { return _epoch; }
+
+        inline size_t num_generations() const { return _generations.size(); }
+
+        // Generation of epoch() - age
+        inline const map_t& generation(const size_t age) const
+        {
+            assert(age < _generations.size());
+            return *_generations[_generations.size() - 1U - age];
+        }
+
+        // Number of entries over all generations (an entry in several generations counts several times)
+        inline size_t size() const
+        {
+            size_t result = 0U;
+            for (const auto& generation : _generations)
+                result += generation->size();
+            return result;
+        }
+
+        inline bool empty() const { return size() == 0U; }
+
+        inline bool contains(const coord_t& coord) const
+        {
+            for (const auto& generation : _generations)
+            {
+                if (generation->contains(_shift(coord, generation->num_resizes())))
+                    return true;
+            }
+            return false;
+        }
+
+        // Merge the data of coord (or of the coarser cell containing coord) over all generations into result, oldest first; returns whether coord was found
+        inline bool find(const coord_t& coord, _Td& result) const
+        {
+            bool found = false;
+            for (const auto& generation : _generations)
+            {
+                auto iter = generation->find(_shift(coord, generation->num_resizes()));
+                if (iter == generation->end())
+                    continue;
+                if (found)
+                    merge(result, (*iter).second);
+                else
+                    result = (*iter).second;
+                found = true;
+            }
+            return found;
+        }
+
+        // Call f(coord, data, num_resizes) for the entries of all generations, oldest first, with coord at the resolution of its generation
+        template<class _Tf>
+        inline void for_each(_Tf f) const
+        {
+            for (const auto& generation : _generations)
+            {
+                for (const auto& item : *generation)
+                    f(item.first, item.second, generation->num_resizes());
+            }
+        }
+
+        inline size_t memory() const
+        {
+            size_t result = sizeof(window_cmap);
+            for (const auto& generation : _generations)
+                result += generation->memory();
+            return result;
+        }
+
+};
+
+
+} // End of namespace tools
+
+
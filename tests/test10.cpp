@@ -0,0 +1,87 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+
+#include "cmap.hpp"
+
+struct data_type
+{
+    uint32_t num;
+};
+
+using octomap = tools::cmap<uint16_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+using  pair_t = octomap::pair_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+bool check(const octomap& my_map)
+{
+    size_t num_cells = 0U;
+    size_t num_found = 0U;
+    bool success = true;
+    my_map.for_each_with_neighbours([&](const pair_t& cell, const std::array<const pair_t *, octomap::num_neighbours>& neighbours)
+    {
+        ++num_cells;
+        size_t k = 0U;
+        for (int dx = -1; dx <= 1; ++dx)
+        for (int dy = -1; dy <= 1; ++dy)
+        for (int dz = -1; dz <= 1; ++dz)
+        {
+            if ((dx == 0) && (dy == 0) && (dz == 0))
+                continue;
+            const coord_t coord = { static_cast<uint16_t>(cell.first[0] + dx), static_cast<uint16_t>(cell.first[1] + dy), static_cast<uint16_t>(cell.first[2] + dz) };
+            const bool wrapped = ((cell.first[0] == 0U) && (dx < 0)) || ((cell.first[1] == 0U) && (dy < 0)) || ((cell.first[2] == 0U) && (dz < 0))
+                              || ((cell.first[0] == UINT16_MAX) && (dx > 0)) || ((cell.first[1] == UINT16_MAX) && (dy > 0)) || ((cell.first[2] == UINT16_MAX) && (dz > 0));
+            auto iter = my_map.find(coord);
+            if ((iter == my_map.end()) || wrapped)
+                success = success && (neighbours[k] == nullptr);
+            else
+            {
+                success = success && (neighbours[k] != nullptr) && ((*neighbours[k]).first == coord) && (&((*iter).second) == &(neighbours[k]->second));
+                ++num_found;
+            }
+            ++k;
+        }
+    });
+    std::cout << "Visited " << num_cells << " cells with " << num_found << " neighbours" << std::endl;
+    return success && (num_cells == my_map.size());
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint16_t> co(0, 40);
+
+    octomap my_map;
+    for (uint32_t count = 0; count < 20000U; ++count)
+        my_map.insert({ co(gen), co(gen), co(gen) }, { 1U });
+    my_map.insert({ 0, 0, 0 }, { 1U });
+    my_map.insert({ UINT16_MAX, UINT16_MAX, UINT16_MAX }, { 1U });
+
+    if (!check(my_map))
+        return 255;
+
+    my_map.resize();
+    my_map.resize();
+
+    if (!check(my_map))
+        return 253;
+
+    return 0;
+}
+
@@ -0,0 +1,100 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <map>
+#include <vector>
+
+#include "cmap.hpp"
+
+struct data_type
+{
+    uint32_t num;
+};
+
+using octomap = tools::cmap<uint32_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+// Reference labelling: flood fill through std::map
+std::vector<size_t> flood(const octomap& my_map, const tools::connectivity conn)
+{
+    std::map<coord_t, size_t> index;
+    std::vector<coord_t> coords;
+    for (const auto& pair : my_map)
+    {
+        index[pair.first] = coords.size();
+        coords.push_back(pair.first);
+    }
+
+    const size_t none = coords.size();
+    std::vector<size_t> labels(coords.size(), none);
+    size_t num_labels = 0U;
+    for (size_t start = 0U; start < coords.size(); ++start)
+    {
+        if (labels[start] != none)
+            continue;
+        std::vector<size_t> stack = { start };
+        labels[start] = num_labels;
+        while (!stack.empty())
+        {
+            const coord_t coord = coords[stack.back()];
+            stack.pop_back();
+            for (int dx = -1; dx <= 1; ++dx)
+            for (int dy = -1; dy <= 1; ++dy)
+            for (int dz = -1; dz <= 1; ++dz)
+            {
+                const int num_nonzero = (dx != 0) + (dy != 0) + (dz != 0);
+                if ((num_nonzero == 0) || ((conn == tools::connectivity::face) && (num_nonzero != 1)))
+                    continue;
+                auto iter = index.find({ coord[0] + dx, coord[1] + dy, coord[2] + dz });
+                if ((iter != index.end()) && (labels[(*iter).second] == none))
+                {
+                    labels[(*iter).second] = num_labels;
+                    stack.push_back((*iter).second);
+                }
+            }
+        }
+        ++num_labels;
+    }
+    return labels;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint32_t> co(1000, 1040);
+
+    octomap my_map;
+    for (uint32_t count = 0; count < 12000U; ++count)
+        my_map.insert({ co(gen), co(gen), co(gen) }, { 1U });
+
+    for (const tools::connectivity conn : { tools::connectivity::face, tools::connectivity::full })
+    {
+        const std::vector<size_t> labels    = my_map.connected_components(conn);
+        const std::vector<size_t> reference = flood(my_map, conn);
+        size_t num_labels = 0U;
+        for (const size_t label : labels)
+            num_labels = std::max(num_labels, label + 1U);
+        std::cout << "Found " << num_labels << " components in " << my_map.size() << " cells" << std::endl;
+        if (labels != reference)
+            return 255;
+    }
+
+    return 0;
+}
+
@@ -0,0 +1,90 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <map>
+
+#include "cmap.hpp"
+
+struct data_type
+{
+    uint64_t num;
+    double   sum;
+};
+
+using hypermap = tools::cmap<uint16_t, 4, data_type>;
+using   flatmap = tools::cmap<uint16_t, 2, data_type>;
+using   coord_t = hypermap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+    left.sum += right.sum;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint16_t> co(0, 255);
+    std::uniform_real_distribution<double>  dt(0.0, 1.0);
+
+    hypermap my_map;
+    for (uint32_t count = 0; count < 200000U; ++count)
+        my_map.insert({ co(gen), co(gen), static_cast<uint16_t>(co(gen) / 16), co(gen) }, { 1U, dt(gen) });
+    my_map.resize();
+
+    // Marginal over dimensions 2 and 0 (in that order)
+    std::map<std::array<uint16_t, 2>, data_type> reference;
+    for (const auto& pair : my_map)
+    {
+        auto iter = reference.find({ pair.first[2], pair.first[0] });
+        if (iter == reference.end())
+            reference[{ pair.first[2], pair.first[0] }] = pair.second;
+        else
+            merge((*iter).second, pair.second);
+    }
+
+    flatmap marginal;
+    marginal.insert({ 1, 1 }, { 1000U, 0.0 }); // Overwritten by project
+    my_map.project<2, 0>(marginal);
+
+    std::cout << "Projected " << my_map.size() << " cells onto " << marginal.size() << " cells" << std::endl;
+    if ((marginal.size() != reference.size()) || (marginal.num_resizes() != my_map.num_resizes()))
+        return 255;
+
+    uint64_t total = 0U;
+    std::array<uint16_t, 2> previous = { 0, 0 };
+    bool first = true;
+    for (const auto& pair : marginal)
+    {
+        auto iter = reference.find(pair.first);
+        if ((iter == reference.end()) || ((*iter).second.num != pair.second.num) || (fabs((*iter).second.sum - pair.second.sum) > 1e-9))
+            return 253;
+        if (!first && !(previous < pair.first) && !(pair.first < previous))
+            return 251;
+        first = false;
+        previous = pair.first;
+        total += pair.second.num;
+    }
+    if (total != 200000U)
+        return 249;
+
+    // The projected map is a regular cmap
+    marginal.insert({ 0, 0 }, { 1U, 0.0 });
+    marginal.resize();
+    if (marginal.find({ 0, 0 }) == marginal.end())
+        return 247;
+
+    return 0;
+}
+
@@ -0,0 +1,92 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+
+#include "cmap.hpp"
+
+struct data_type
+{
+    uint32_t num;
+};
+
+using octomap = tools::cmap<uint32_t, 3, data_type>;
+using quadmap = tools::cmap<uint32_t, 2, data_type>;
+using coord_t = octomap::coord_t;
+using  pair_t = octomap::pair_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint32_t> co(0, 127);
+    std::uniform_int_distribution<uint32_t> dt(1, 100);
+
+    octomap my_map;
+    for (uint32_t count = 0; count < 100000U; ++count)
+        my_map.insert({ co(gen), co(gen), co(gen) }, { dt(gen) });
+
+    for (size_t dim = 0U; dim < 3U; ++dim)
+    {
+        for (const uint32_t value : { 0U, 17U, 64U, 127U, 128U, 1000000U })
+        {
+            size_t num_scan = 0U;
+            uint64_t sum_scan = 0U;
+            for (const auto& pair : my_map)
+            {
+                if (pair.first[dim] == value)
+                {
+                    ++num_scan;
+                    sum_scan += pair.second.num;
+                }
+            }
+
+            size_t num_slice = 0U;
+            uint64_t sum_slice = 0U;
+            bool success = true;
+            my_map.slice(dim, value, [&](const pair_t& pair)
+            {
+                ++num_slice;
+                sum_slice += pair.second.num;
+                success = success && (pair.first[dim] == value);
+            });
+            if (!success || (num_scan != num_slice) || (sum_scan != sum_slice))
+                return 255;
+
+            quadmap plane;
+            my_map.slice(dim, value, plane);
+            if (plane.size() != num_slice)
+                return 253;
+            for (const auto& pair : plane)
+            {
+                coord_t coord = { value, value, value };
+                for (size_t idx = 0U, jdx = 0U; idx < 3U; ++idx)
+                {
+                    if (idx != dim)
+                        coord[idx] = pair.first[jdx++];
+                }
+                auto iter = my_map.find(coord);
+                if ((iter == my_map.end()) || ((*iter).second.num != pair.second.num))
+                    return 251;
+            }
+        }
+        std::cout << "Slices along dimension " << dim << " agree with a full scan" << std::endl;
+    }
+
+    return 0;
+}
+
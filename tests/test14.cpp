@@ -0,0 +1,109 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "cmap.hpp"
+
+struct data_type
+{
+    double s;
+    double p;
+};
+
+using octomap = tools::cmap<uint32_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.s += right.s;
+    left.p *= right.p; // Can decrease key(data) below
+}
+
+double key(const data_type& data)
+{
+    return data.s * data.p;
+}
+
+bool check(const octomap& my_map, const size_t k)
+{
+    std::vector<double> reference;
+    for (auto iter = my_map.cbegin(); iter != my_map.cend(); ++iter) // Reading through const_iterator leaves the bounds alone
+        reference.push_back(key((*iter).second));
+    std::sort(reference.begin(), reference.end(), [](double left, double right){ return left > right; });
+    reference.resize(std::min(k, reference.size()));
+
+    const std::vector<octomap::const_iterator> result = my_map.top_k(k);
+    if (result.size() != reference.size())
+        return false;
+    for (size_t idx = 0U; idx < result.size(); ++idx)
+    {
+        if (key((*(result[idx])).second) != reference[idx])
+            return false;
+        if (my_map.find((*(result[idx])).first) == my_map.end())
+            return false;
+    }
+    std::cout << "Top " << k << " of " << my_map.size() << " cells: highest key = " << (result.empty() ? 0.0 : reference[0]) << std::endl;
+    return true;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint32_t> co(0, 255);
+    std::uniform_real_distribution<double>  dt(0.1, 2.0);
+
+    octomap my_map;
+    for (uint32_t count = 0; count < 10000U; ++count)
+        my_map.insert({ co(gen), co(gen), co(gen) }, { dt(gen), dt(gen) });
+
+    my_map.track_max(key);
+    if (!check(my_map, 10U))
+        return 255;
+
+    // Bounds are maintained on insert (with merge) and resize
+    for (uint32_t count = 0; count < 50000U; ++count)
+    {
+        my_map.insert({ co(gen), co(gen), co(gen) }, { dt(gen), dt(gen) });
+        if ((count % 10000U == 0U) && !check(my_map, 25U))
+            return 253;
+    }
+
+    // Data changed through operator[] and iterators is tracked
+    my_map[{ 7, 7, 7 }] = { 1000.0, 1.0 };
+    if (!check(my_map, 25U))
+        return 251;
+    my_map[{ 7, 7, 7 }].s = 3000.0;
+    my_map[{ 9, 9, 9 }] = { 1.0, 1.0 };
+    (*(my_map.find({ 9, 9, 9 }))).second = { 2000.0, 1.0 };
+    if (!check(my_map, 25U) || (key((*(my_map.top_k(2U)[1])).second) != 2000.0))
+        return 251;
+    for (auto iter = my_map.begin(); iter != my_map.end(); ++iter)
+        (*iter).second.p *= 1.5;
+    if (!check(my_map, 25U))
+        return 251;
+
+    my_map.resize();
+    if (!check(my_map, 100U))
+        return 249;
+
+    for (uint32_t count = 0; count < 5000U; ++count)
+        my_map.erase({ co(gen), co(gen), co(gen) });
+    if (!check(my_map, 100U) || !check(my_map, my_map.size() + 5U))
+        return 247;
+
+    return 0;
+}
+
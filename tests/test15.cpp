@@ -0,0 +1,116 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <map>
+#include <cmath>
+
+#include "cmap.hpp"
+
+struct data_type
+{
+    double w;
+};
+
+using octomap = tools::cmap<uint16_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.w += right.w;
+}
+
+double weight(const data_type& data)
+{
+    return data.w;
+}
+
+// Largest deviation of the sampled frequencies from the expected ones, in standard deviations
+double deviation(const octomap& my_map, const std::vector<octomap::const_iterator>& result, const bool weighted)
+{
+    std::map<coord_t, size_t> hits;
+    for (const auto& iter : result)
+        ++hits[(*iter).first];
+    double total = 0.0;
+    for (const auto& pair : my_map)
+        total += weighted ? weight(pair.second) : 1.0;
+    double worst = 0.0;
+    for (const auto& pair : my_map)
+    {
+        const double p = (weighted ? weight(pair.second) : 1.0) / total;
+        const double expected = p * result.size();
+        const double sigma = std::sqrt(expected * (1.0 - p)) + 1e-12;
+        auto iter = hits.find(pair.first);
+        const double observed = (iter == hits.end()) ? 0.0 : (*iter).second;
+        worst = std::max(worst, std::fabs(observed - expected) / sigma);
+    }
+    return worst;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint16_t> co(0, 1023);
+    std::uniform_real_distribution<double>  dt(0.5, 1.5);
+
+    octomap my_map;
+    for (uint32_t count = 0; count < 200U; ++count)
+        my_map.insert({ co(gen), co(gen), co(gen) }, { dt(gen) });
+    my_map.insert({ 1, 2, 3 }, { 100.0 }); // Heavy cell
+
+    // Uniform sampling, single and batch
+    const size_t number = 200000U;
+    std::vector<octomap::const_iterator> result = my_map.sample(gen, number);
+    if (result.size() != number)
+        return 255;
+    if (my_map.sample(gen) == my_map.cend())
+        return 253;
+    const double uniform = deviation(my_map, result, false);
+    std::cout << "Uniform sampling: worst deviation = " << uniform << " sigma" << std::endl;
+    if (uniform > 6.0)
+        return 251;
+
+    // Weighted sampling, with the sums maintained on insert, erase and resize
+    my_map.track_sum(weight);
+    for (uint32_t count = 0; count < 100U; ++count)
+        my_map.insert({ co(gen), co(gen), co(gen) }, { dt(gen) });
+    my_map.insert({ 1, 2, 3 }, { 50.0 });
+    for (uint32_t count = 0; count < 50U; ++count)
+        my_map.erase(my_map.cbegin());
+    my_map.erase({ 1, 2, 3 });
+    my_map.insert({ 1, 2, 3 }, { 150.0 });
+    my_map.resize();
+    for (uint32_t count = 0; count < 10U; ++count)
+        my_map.erase(my_map.sample(gen));
+
+    // Weights changed through operator[] and iterators are tracked
+    my_map[{ 500, 500, 500 }].w = 80.0;
+    (*(my_map.begin())).second.w = 40.0;
+
+    result = my_map.weighted_sample(gen, number);
+    if ((result.size() != number) || (my_map.weighted_sample(gen) == my_map.cend()))
+        return 249;
+    const double weighted = deviation(my_map, result, true);
+    std::cout << "Weighted sampling: worst deviation = " << weighted << " sigma" << std::endl;
+    if (weighted > 6.0)
+        return 247;
+
+    octomap empty_map;
+    if ((empty_map.sample(gen) != empty_map.cend()) || !empty_map.sample(gen, 10U).empty())
+        return 245;
+
+    return 0;
+}
+
+
@@ -0,0 +1,134 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <set>
+
+#include "cmap.hpp"
+
+struct data_type
+{
+    uint32_t num;
+};
+
+using octomap = tools::cmap<uint32_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+// No false negatives: every probe agrees with the reference
+bool check(const octomap& my_map, const std::set<coord_t>& reference, std::mt19937& gen)
+{
+    std::uniform_int_distribution<uint32_t> co(0, 4095);
+    if (my_map.size() != reference.size())
+        return false;
+    for (const auto& coord : reference)
+    {
+        if (!my_map.contains(coord) || (my_map.find(coord) == my_map.end()))
+            return false;
+    }
+    for (uint32_t count = 0; count < 100000U; ++count)
+    {
+        const coord_t coord = { co(gen), co(gen), co(gen) };
+        const bool present = reference.find(coord) != reference.end();
+        if ((my_map.contains(coord) != present) || ((my_map.find(coord) != my_map.end()) != present))
+            return false;
+    }
+    return true;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint32_t> co(0, 4095);
+
+    octomap my_map;
+    std::set<coord_t> reference;
+    for (uint32_t count = 0; count < 5000U; ++count)
+    {
+        const coord_t coord = { co(gen), co(gen), co(gen) };
+        my_map.insert(coord, { 1U });
+        reference.insert(coord);
+    }
+
+    // Timing of misses without and with the filter
+    std::vector<coord_t> misses;
+    while (misses.size() < 200000U)
+    {
+        const coord_t coord = { co(gen) + 8192U, co(gen), co(gen) };
+        misses.push_back(coord);
+    }
+    size_t hits = 0U;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const auto& coord : misses)
+        hits += my_map.contains(coord) ? 1U : 0U;
+    auto stop = std::chrono::high_resolution_clock::now();
+    std::cout << "Misses without filter : " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() << " us" << std::endl;
+
+    my_map.use_filter();
+    start = std::chrono::high_resolution_clock::now();
+    for (const auto& coord : misses)
+        hits += my_map.contains(coord) ? 1U : 0U;
+    stop = std::chrono::high_resolution_clock::now();
+    std::cout << "Misses with filter    : " << std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() << " us" << std::endl;
+    if ((hits != 0U) || !check(my_map, reference, gen))
+        return 255;
+
+    // Maintained on insert (with growth beyond the capacity) and operator[]
+    for (uint32_t count = 0; count < 20000U; ++count)
+    {
+        const coord_t coord = { co(gen), co(gen), co(gen) };
+        if (count & 1U)
+            my_map.insert(coord, { 1U });
+        else
+            my_map[coord].num += 1U;
+        reference.insert(coord);
+    }
+    if (!check(my_map, reference, gen))
+        return 253;
+
+    // Rebuilt after erase and resize
+    for (uint32_t count = 0; count < 15000U; ++count)
+    {
+        reference.erase((*(my_map.cbegin())).first);
+        my_map.erase(my_map.cbegin());
+    }
+    for (uint32_t count = 0; count < 3000U; ++count)
+    {
+        const coord_t coord = *(reference.begin());
+        reference.erase(coord);
+        if (my_map.erase(coord) != 1U)
+            return 251;
+    }
+    if (!check(my_map, reference, gen))
+        return 249;
+
+    my_map.resize();
+    std::set<coord_t> resized;
+    for (const auto& coord : reference)
+        resized.insert({ coord[0] >> 1U, coord[1] >> 1U, coord[2] >> 1U });
+    if (!check(my_map, resized, gen))
+        return 247;
+
+    my_map.clear();
+    if (!check(my_map, std::set<coord_t>(), gen))
+        return 245;
+
+    return 0;
+}
+
+
@@ -0,0 +1,123 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "cmap.hpp"
+#include "hilbert.hpp"
+
+struct data_type
+{
+    uint32_t num;
+};
+
+using octomap = tools::cmap<uint32_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+coord_t index(const coord_t& coord)
+{
+    coord_t result;
+    tools::hilbert<uint32_t, 3>(&coord[0], &result[0]);
+    return result;
+}
+
+// for_each_hilbert visits the entries in the order of their Hilbert index
+bool check(const octomap& my_map)
+{
+    std::vector<coord_t> reference;
+    for (const auto& pair : my_map)
+        reference.push_back(pair.first);
+    std::sort(reference.begin(), reference.end(), [](const coord_t& left, const coord_t& right){ return index(left) < index(right); });
+
+    std::vector<coord_t> result;
+    my_map.for_each_hilbert([&](const octomap::pair_t& pair){ result.push_back(pair.first); });
+    return result == reference;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+
+    // Generated kernels: decode inverts encode
+    {
+        std::uniform_int_distribution<uint16_t> c16(0, UINT16_MAX);
+        std::uniform_int_distribution<uint64_t> c64(0, UINT64_MAX);
+        for (uint32_t count = 0; count < 100000U; ++count)
+        {
+            const uint16_t coord16[5] = { c16(gen), c16(gen), c16(gen), c16(gen), c16(gen) };
+            uint16_t index16[5], result16[5];
+            tools::hilbert<uint16_t, 5>(coord16, index16);
+            tools::unhilbert<uint16_t, 5>(index16, result16);
+            const uint64_t coord64[2] = { c64(gen), c64(gen) };
+            uint64_t index64[2], result64[2];
+            tools::hilbert<uint64_t, 2>(coord64, index64);
+            tools::unhilbert<uint64_t, 2>(index64, result64);
+            if (!std::equal(coord16, coord16 + 5, result16) || !std::equal(coord64, coord64 + 2, result64))
+                return 255;
+        }
+    }
+
+    // Sparse entries over the full range and a dense cluster
+    {
+        std::uniform_int_distribution<uint32_t> sparse(0, UINT32_MAX);
+        std::uniform_int_distribution<uint32_t> dense(1000, 1063);
+        octomap my_map;
+        for (uint32_t count = 0; count < 20000U; ++count)
+        {
+            my_map.insert({ sparse(gen), sparse(gen), sparse(gen) }, { 1U });
+            my_map.insert({ dense(gen), dense(gen), dense(gen) }, { 1U });
+        }
+        if (!check(my_map))
+            return 253;
+        for (uint32_t count = 0; count < 5U; ++count)
+            my_map.resize();
+        if (!check(my_map))
+            return 251;
+    }
+
+    // Consecutive cells of a full grid are face neighbours
+    {
+        octomap my_map;
+        for (uint32_t x = 0; x < 16U; ++x)
+            for (uint32_t y = 0; y < 16U; ++y)
+                for (uint32_t z = 0; z < 16U; ++z)
+                    my_map.insert({ x, y, z }, { 1U });
+        coord_t previous = { 0U, 0U, 0U };
+        size_t count = 0U, jumps = 0U;
+        my_map.for_each_hilbert([&](const octomap::pair_t& pair)
+        {
+            if (count++ != 0U)
+            {
+                uint32_t distance = 0U;
+                for (size_t dim = 0U; dim < 3U; ++dim)
+                    distance += (pair.first[dim] > previous[dim]) ? pair.first[dim] - previous[dim] : previous[dim] - pair.first[dim];
+                jumps += (distance == 1U) ? 0U : 1U;
+            }
+            previous = pair.first;
+        });
+        std::cout << "Hilbert walk over " << count << " cells with " << jumps << " jumps" << std::endl;
+        if ((count != my_map.size()) || (jumps != 0U))
+            return 249;
+    }
+
+    return 0;
+}
+
+
@@ -0,0 +1,108 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <memory>
+
+#include "cmap.hpp"
+
+struct data_type
+{
+    uint32_t num;
+
+    bool operator==(const data_type& other) const { return num == other.num; }
+};
+
+using octomap = tools::cmap<uint32_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+double lookup(const octomap& my_map, const std::vector<coord_t>& queries)
+{
+    size_t found = 0U;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const auto& coord : queries)
+        found += (my_map.find(coord) != my_map.end()) ? 1U : 0U;
+    auto stop = std::chrono::high_resolution_clock::now();
+    return (found == queries.size()) ? std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() : -1.0;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint32_t> co(0, 65535);
+
+    // Incremental inserts, interleaved with unrelated allocations which scatter the nodes over the heap
+    octomap my_map, replica;
+    std::vector<coord_t> queries;
+    std::vector<std::unique_ptr<std::vector<uint32_t>>> noise;
+    for (uint32_t count = 0; count < 50000U; ++count)
+    {
+        const coord_t coord = { co(gen), co(gen), co(gen) };
+        my_map.insert(coord, { count });
+        replica.insert(coord, { count });
+        queries.push_back(coord);
+        noise.push_back(std::make_unique<std::vector<uint32_t>>(1U + (count % 13U)));
+    }
+    noise.clear();
+    std::shuffle(queries.begin(), queries.end(), gen);
+
+    const double before = lookup(my_map, queries);
+    const size_t memory = my_map.memory();
+    my_map.compact();
+    const double after  = lookup(my_map, queries);
+    std::cout << "Lookups before compact() : " << before << " us" << std::endl;
+    std::cout << "Lookups after  compact() : " << after  << " us" << std::endl;
+    if ((before < 0.0) || (after < 0.0))
+        return 255;
+
+    // The leafs are shrunk to fit
+    if (my_map.memory() >= memory)
+        return 254;
+
+    // Content, and forward and reverse iteration (which follow the path of the iterator) are unchanged
+    if (my_map != replica)
+        return 253;
+    size_t forward = 0U, backward = 0U;
+    for (auto iter = my_map.begin(); iter != my_map.end(); ++iter)
+        ++forward;
+    for (auto iter = my_map.rbegin(); iter != my_map.rend(); ++iter)
+        ++backward;
+    if ((forward != my_map.size()) || (backward != my_map.size()))
+        return 251;
+
+    // The map remains mutable
+    for (uint32_t count = 0; count < 2000U; ++count)
+    {
+        const coord_t coord = { co(gen), co(gen), co(gen) };
+        my_map.insert(coord, { count });
+        replica.insert(coord, { count });
+        my_map.erase(queries[count]);
+        replica.erase(queries[count]);
+    }
+    my_map.resize();
+    replica.resize();
+    my_map.compact();
+    if (my_map != replica)
+        return 249;
+
+    return 0;
+}
+
+
@@ -0,0 +1,118 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "cmap.hpp"
+#include "static_cmap.hpp"
+
+struct data_type
+{
+    uint32_t num;
+};
+
+using octomap = tools::cmap<uint32_t, 3, data_type>;
+using frozen  = tools::static_cmap<uint32_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+bool check(const octomap& my_map, std::mt19937& gen, std::uniform_int_distribution<uint32_t>& co)
+{
+    const frozen image(my_map);
+    if ((image.size() != my_map.size()) || (image.num_resizes() != my_map.num_resizes()))
+        return false;
+
+    // Ordered iteration: the order of cmap, with the items within a leaf sorted
+    for (auto iter = image.begin(); iter != image.end(); ++iter)
+    {
+        if ((iter != image.begin()) && !tools::_cmapbase::_morton_less((*(iter - 1)).first, (*iter).first))
+            return false;
+    }
+
+    // Hits and misses
+    for (const auto& pair : my_map)
+    {
+        auto iter = image.find(pair.first);
+        if ((iter == image.end()) || ((*iter).second.num != pair.second.num))
+            return false;
+    }
+    for (uint32_t count = 0; count < 100000U; ++count)
+    {
+        const coord_t coord = { co(gen), co(gen), co(gen) };
+        if (image.contains(coord) != my_map.contains(coord))
+            return false;
+    }
+
+    // Box queries against a scan
+    for (uint32_t count = 0; count < 50U; ++count)
+    {
+        coord_t lower, upper;
+        for (size_t dim = 0U; dim < 3U; ++dim)
+        {
+            lower[dim] = co(gen);
+            upper[dim] = co(gen);
+            if (upper[dim] < lower[dim])
+                std::swap(lower[dim], upper[dim]);
+        }
+        size_t expected = 0U, found = 0U;
+        for (const auto& pair : my_map)
+            expected += ((lower[0] <= pair.first[0]) && (pair.first[0] <= upper[0])
+                      && (lower[1] <= pair.first[1]) && (pair.first[1] <= upper[1])
+                      && (lower[2] <= pair.first[2]) && (pair.first[2] <= upper[2])) ? 1U : 0U;
+        bool inside = true;
+        image.box(lower, upper, [&](const frozen::pair_t& pair)
+        {
+            ++found;
+            for (size_t dim = 0U; dim < 3U; ++dim)
+                inside = inside && (lower[dim] <= pair.first[dim]) && (pair.first[dim] <= upper[dim]);
+        });
+        if (!inside || (found != expected))
+            return false;
+    }
+
+    std::cout << "static_cmap with " << image.size() << " entries: " << image.memory() - image.size() * sizeof(frozen::pair_t)
+              << " bytes besides the entries (" << sizeof(octomap::node_t) << " bytes per cmap node)" << std::endl;
+    return true;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint32_t> co(0, 1023);
+    std::normal_distribution<double> cluster(512.0, 16.0);
+
+    octomap my_map;
+    if (!check(my_map, gen, co))
+        return 255;
+
+    for (uint32_t count = 0; count < 50000U; ++count)
+    {
+        my_map.insert({ co(gen), co(gen), co(gen) }, { 1U });
+        my_map.insert({ static_cast<uint32_t>(cluster(gen)), static_cast<uint32_t>(cluster(gen)), static_cast<uint32_t>(cluster(gen)) }, { 1U });
+    }
+    if (!check(my_map, gen, co))
+        return 253;
+
+    my_map.resize();
+    if (!check(my_map, gen, co))
+        return 251;
+
+    return 0;
+}
+
+
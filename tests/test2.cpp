@@ -11,6 +11,8 @@
 
 #include <iostream>
 #include <random>
+#include <vector>
+#include <type_traits>
 
 #include "cmap.hpp"
 
@@ -23,6 +25,9 @@ using octomap = tools::cmap<uint32_t, 3, data_type>;
 using coord_t = octomap::coord_t;
 using  pair_t = octomap::pair_t;
 
+// Iterators hold their path inline, so copies do not allocate
+static_assert(std::is_trivially_copyable<octomap::const_iterator>::value, "iterators should be trivially copyable");
+
 void merge(data_type& left, const data_type& right)
 {
     left.radius = sqrt(left.radius * left.radius + right.radius * right.radius);
@@ -76,6 +81,29 @@ int main()
 
         if (fabs(check_fw - check_bw) > 1e-6)
             return 251;
+
+        // Iterators obtained through find continue in iteration order
+        std::vector<coord_t> order;
+        for (const pair_t& pair : my_map)
+            order.push_back(pair.first);
+        for (size_t start = 0U; start < order.size(); start += 7U)
+        {
+            size_t idx = start;
+            for (auto iter = my_map.find(order[start]); iter != my_map.end(); ++iter, ++idx)
+                if ((*iter).first != order[idx])
+                    return 249;
+            if (idx != order.size())
+                return 249;
+        }
+
+        // Copies of an iterator continue independently
+        auto first = my_map.cbegin();
+        auto second = first;
+        for (size_t idx = 0U; idx < order.size(); ++idx, first++, ++second)
+            if (((*first).first != order[idx]) || ((*second).first != order[idx]))
+                return 247;
+        if ((first != my_map.cend()) || (second != my_map.cend()))
+            return 247;
     }
 
     return 0;
@@ -0,0 +1,122 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "cmap.hpp"
+
+struct data_type
+{
+    uint32_t num;
+    float    val;
+
+    bool operator==(const data_type& other) const { return (num == other.num) && (val == other.val); }
+};
+
+using octomap = tools::cmap<uint32_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+    left.val += right.val;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint32_t> cluster(1000000, 1000063);
+    std::uniform_int_distribution<uint32_t> dt(1, 5);
+
+    octomap my_map, replica;
+    std::vector<coord_t> samples;
+    for (uint32_t count = 0; count < 100000U; ++count)
+    {
+        const coord_t coord = { cluster(gen), cluster(gen), cluster(gen) };
+        const data_type data = { dt(gen), 0.5f };
+        my_map.insert(coord, data);
+        replica.insert(coord, data);
+        samples.push_back(coord);
+    }
+
+    // All leafs were just referenced: the first sweep only clears their bits
+    const size_t hot = my_map.memory();
+    if (my_map.compress_idle() != 0U)
+        return 255;
+    const size_t number = my_map.compress_idle();
+    const size_t cold = my_map.memory();
+    std::cout << "Compressed " << number << " leafs: " << hot << " --> " << cold << " bytes" << std::endl;
+    if ((number == 0U) || (5U * cold >= 4U * hot))
+        return 253;
+
+    // Lookups decompress on demand, and mark the leafs as referenced
+    for (uint32_t count = 0; count < 1000U; ++count)
+    {
+        auto iter = my_map.find(samples[count]);
+        if ((iter == my_map.end()) || !((*iter).second == (*(replica.find(samples[count]))).second))
+            return 251;
+    }
+    const size_t number2 = my_map.compress_idle();
+    std::cout << "Second sweep compressed " << number2 << " leafs" << std::endl;
+
+    // Iteration, insertion and erasure on cold leafs
+    size_t forward = 0U;
+    for (auto iter = my_map.cbegin(); iter != my_map.cend(); ++iter)
+        ++forward;
+    if (forward != replica.size())
+        return 249;
+    my_map.compress_idle();
+    my_map.compress_idle();
+    for (uint32_t count = 0; count < 5000U; ++count)
+    {
+        my_map.insert(samples[count], { 1U, 1.0f });
+        replica.insert(samples[count], { 1U, 1.0f });
+        my_map.erase(samples[count + 5000U]);
+        replica.erase(samples[count + 5000U]);
+    }
+    if (my_map.size() != replica.size())
+        return 247;
+    my_map.compress_idle();
+    if (my_map != replica)
+        return 245;
+
+    // Operations over the whole tree
+    my_map.compress_idle();
+    my_map.compress_idle();
+    my_map.resize();
+    replica.resize();
+    if (my_map != replica)
+        return 243;
+    my_map.compress_idle();
+    my_map.compress_idle();
+    my_map.track_max([](const data_type& data){ return data.num; });
+    replica.track_max([](const data_type& data){ return data.num; });
+    if ((*(my_map.top_k(1U)[0])).second.num != (*(replica.top_k(1U)[0])).second.num)
+        return 241;
+
+    // Queries only decompress the leafs which they visit
+    my_map.compress_idle();
+    my_map.compress_idle();
+    const size_t frozen = my_map.memory();
+    std::mt19937 rng(7U);
+    my_map.sample(rng);
+    my_map.top_k(3U);
+    std::cout << "Queries on the compressed map: " << frozen << " --> " << my_map.memory() << " bytes" << std::endl;
+    if (10U * (my_map.memory() - frozen) > replica.memory() - frozen)
+        return 239;
+
+    return 0;
+}
+
+
@@ -0,0 +1,119 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <array>
+
+#include "cmap.hpp"
+#include "slab_cmap.hpp"
+
+struct histogram
+{
+    std::array<uint32_t, 256> bins = {};
+
+    bool operator==(const histogram& other) const { return bins == other.bins; }
+};
+
+using slabmap = tools::slab_cmap<uint16_t, 3, histogram>;
+using octomap = tools::cmap<uint16_t, 3, histogram>;
+using coord_t = slabmap::coord_t;
+
+void merge(histogram& left, const histogram& right)
+{
+    for (size_t bin = 0; bin < left.bins.size(); ++bin)
+        left.bins[bin] += right.bins[bin];
+}
+
+bool equal(slabmap& slab, const octomap& reference)
+{
+    if ((slab.size() != reference.size()) || (slab.num_resizes() != reference.num_resizes()))
+        return false;
+    bool same = true;
+    slab.for_each([&](const coord_t& coord, histogram& data)
+    {
+        auto iter = reference.find(coord);
+        same = same && (iter != reference.end()) && ((*iter).second == data);
+    });
+    for (const auto& item : reference)
+    {
+        const histogram * found = slab.find(item.first);
+        same = same && (found != nullptr) && (*found == item.second);
+    }
+    return same;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint16_t> dist(0, 31);
+    std::uniform_int_distribution<uint16_t> bin(0, 255);
+
+    slabmap my_map, other;
+    octomap reference, replica;
+    for (uint32_t count = 0; count < 20000U; ++count)
+    {
+        const coord_t coord = { dist(gen), dist(gen), dist(gen) };
+        histogram data;
+        data.bins[bin(gen)] = 1U;
+        my_map.insert(coord, data);
+        reference.insert(coord, data);
+        if (count % 2U == 0U)
+        {
+            const coord_t shifted = { dist(gen), dist(gen), static_cast<uint16_t>(dist(gen) + 16U) };
+            other.insert(shifted, data);
+            replica.insert(shifted, data);
+        }
+    }
+
+    // Merged payloads released their slots
+    std::cout << "Slab holds " << my_map.slots() << " slots for " << my_map.size() << " entries" << std::endl;
+    if (!equal(my_map, reference) || (my_map.slots() > reference.size() + 1U) || (my_map.slots() != my_map.size() + my_map.released()))
+        return 255;
+
+    my_map.resize();
+    reference.resize();
+    if (!equal(my_map, reference) || (my_map.slots() != my_map.size() + my_map.released()))
+        return 255;
+
+    // Erased slots are reused
+    const size_t slots = my_map.slots();
+    for (uint32_t count = 0; count < 1000U; ++count)
+    {
+        const coord_t coord = { dist(gen), dist(gen), dist(gen) };
+        if (my_map.erase(coord) != reference.erase(coord))
+            return 255;
+    }
+    for (uint32_t count = 0; count < 1000U; ++count)
+    {
+        const coord_t coord = { dist(gen), dist(gen), dist(gen) };
+        my_map[coord].bins[7] += 3U;
+        reference[coord].bins[7] += 3U;
+    }
+    if (!equal(my_map, reference) || (my_map.slots() > slots))
+        return 255;
+
+    // The chunks of the other slab move into this one
+    other.resize();
+    replica.resize();
+    my_map.merge_union(other);
+    reference.merge_union(replica);
+    if (!equal(my_map, reference) || !other.empty() || (other.slots() != 0U))
+        return 255;
+
+    // Every slot is held by one entry or released
+    if (my_map.slots() != my_map.size() + my_map.released())
+        return 255;
+
+    std::cout << "Slab map with " << my_map.size() << " entries matches the reference" << std::endl;
+    return 0;
+}
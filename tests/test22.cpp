@@ -0,0 +1,134 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <map>
+#include <vector>
+
+#include "wide_cmap.hpp"
+
+struct data_type
+{
+    uint32_t num;
+    float    val;
+};
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+    left.val += right.val;
+}
+
+template<class _Tc, size_t _DIM>
+bool equal(tools::wide_cmap<_Tc, _DIM, data_type>& my_map, const std::map<std::array<_Tc, _DIM>, data_type>& reference)
+{
+    if (my_map.size() != reference.size())
+        return false;
+    size_t number = 0U;
+    bool same = true;
+    my_map.for_each([&](const std::array<_Tc, _DIM>& coord, data_type& data)
+    {
+        auto iter = reference.find(coord);
+        same = same && (iter != reference.end()) && ((*iter).second.num == data.num);
+        ++number;
+    });
+    for (const auto& item : reference)
+    {
+        const data_type * found = my_map.find(item.first);
+        same = same && (found != nullptr) && (found->num == item.second.num);
+    }
+    return same && (number == reference.size());
+}
+
+template<class _Tc, size_t _DIM>
+bool check(std::mt19937& gen, const _Tc spread)
+{
+    typedef std::array<_Tc, _DIM> coord_t;
+    std::uniform_int_distribution<uint32_t> dist(0, spread);
+    std::uniform_int_distribution<uint32_t> dt(1, 5);
+
+    // Repeated coordinates collide
+    std::vector<coord_t> pool(5000U);
+    for (auto& coord : pool)
+        for (size_t dim = 0; dim < _DIM; ++dim)
+            coord[dim] = static_cast<_Tc>(dist(gen) + 7U * dim);
+    std::uniform_int_distribution<size_t> pick(0, pool.size() - 1U);
+
+    tools::wide_cmap<_Tc, _DIM, data_type> my_map;
+    std::map<coord_t, data_type> reference;
+    for (uint32_t count = 0; count < 20000U; ++count)
+    {
+        const coord_t coord = pool[pick(gen)];
+        const data_type data = { dt(gen), 0.5f };
+        my_map.insert(coord, data);
+        auto iter = reference.find(coord);
+        if (iter == reference.end())
+            reference.emplace(coord, data);
+        else
+            merge((*iter).second, data);
+    }
+    if (!equal(my_map, reference))
+        return false;
+
+    for (auto iter = reference.begin(); iter != reference.end(); )
+    {
+        if ((*iter).second.num % 4U == 0U)
+        {
+            if (my_map.erase((*iter).first) != 1U)
+                return false;
+            iter = reference.erase(iter);
+        }
+        else
+            ++iter;
+    }
+    if (!equal(my_map, reference))
+        return false;
+
+    // Two resizes divide every dimension by four
+    for (uint32_t step = 0; step < 2U; ++step)
+    {
+        my_map.resize();
+        std::map<coord_t, data_type> shifted;
+        for (const auto& item : reference)
+        {
+            coord_t coord = item.first;
+            for (size_t dim = 0; dim < _DIM; ++dim)
+                coord[dim] >>= 1U;
+            auto iter = shifted.find(coord);
+            if (iter == shifted.end())
+                shifted.emplace(coord, item.second);
+            else
+                merge((*iter).second, item.second);
+        }
+        reference.swap(shifted);
+        if ((my_map.num_resizes() != step + 1U) || !equal(my_map, reference))
+            return false;
+    }
+
+    std::cout << "wide_cmap with " << _DIM << " dimensions holds " << my_map.size() << " entries" << std::endl;
+    return true;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+
+    if (!check<uint16_t, 12>(gen, 7U) || !check<uint32_t, 16>(gen, 7U) || !check<uint8_t, 20>(gen, 7U) || !check<uint16_t, 6>(gen, 15U))
+        return 255;
+
+    // All bits of the coordinates survive the interleaving
+    if (!check<uint32_t, 10>(gen, 0xffffff00U) || !check<uint16_t, 20>(gen, 0xff00U))
+        return 255;
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <map>
+
+#include "cmap.hpp"
+#include "hilbert.hpp"
+
+struct data_type
+{
+    uint32_t num;
+};
+
+using octomap = tools::cmap<__uint128_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+bool equal(const octomap& my_map, const std::map<coord_t, data_type>& reference)
+{
+    if (my_map.size() != reference.size())
+        return false;
+    size_t number = 0U;
+    for (const auto& item : my_map)
+    {
+        auto iter = reference.find(item.first);
+        if ((iter == reference.end()) || ((*iter).second.num != item.second.num))
+            return false;
+        ++number;
+    }
+    for (const auto& item : reference)
+    {
+        auto iter = my_map.find(item.first);
+        if ((iter == my_map.end()) || ((*iter).second.num != item.second.num))
+            return false;
+    }
+    return number == reference.size();
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937_64 gen(rd());
+    std::uniform_int_distribution<uint64_t> full;
+    std::uniform_int_distribution<uint64_t> near(0, 15);
+    std::uniform_int_distribution<uint32_t> dt(1, 5);
+
+    // Clusters straddling the boundary between the 64-bit limbs, and coordinates spread over all 128 bits
+    const __uint128_t base = (static_cast<__uint128_t>(1U) << 64U) - 8U;
+    octomap my_map;
+    std::map<coord_t, data_type> reference;
+    for (uint32_t count = 0; count < 20000U; ++count)
+    {
+        coord_t coord;
+        for (size_t dim = 0; dim < 3; ++dim)
+            coord[dim] = (count % 4U == 0U) ? ((static_cast<__uint128_t>(full(gen)) << 64U) | full(gen)) : (base + near(gen) + (static_cast<__uint128_t>(dim) << 100U));
+        const data_type data = { dt(gen) };
+        my_map.insert(coord, data);
+        auto iter = reference.find(coord);
+        if (iter == reference.end())
+            reference.emplace(coord, data);
+        else
+            merge((*iter).second, data);
+    }
+    if (!equal(my_map, reference))
+        return 255;
+
+    for (auto iter = reference.begin(); iter != reference.end(); )
+    {
+        if ((*iter).second.num % 3U == 0U)
+        {
+            if (my_map.erase((*iter).first) != 1U)
+                return 255;
+            iter = reference.erase(iter);
+        }
+        else
+            ++iter;
+    }
+    if (!equal(my_map, reference))
+        return 255;
+
+    for (uint32_t step = 0; step < 2U; ++step)
+    {
+        my_map.resize();
+        std::map<coord_t, data_type> shifted;
+        for (const auto& item : reference)
+        {
+            coord_t coord = item.first;
+            for (auto& element : coord)
+                element >>= 1U;
+            auto iter = shifted.find(coord);
+            if (iter == shifted.end())
+                shifted.emplace(coord, item.second);
+            else
+                merge((*iter).second, item.second);
+        }
+        reference.swap(shifted);
+        if (!equal(my_map, reference))
+            return 255;
+    }
+
+    // The generated 128-bit kernels are each other's inverse
+    for (uint32_t count = 0; count < 1000U; ++count)
+    {
+        coord_t coord, perm, index, back;
+        for (auto& element : coord)
+            element = (static_cast<__uint128_t>(full(gen)) << 64U) | full(gen);
+        tools::permute<__uint128_t, 3>(&coord[0], &perm[0]);
+        tools::unravel<__uint128_t, 3>(&perm[0], &back[0]);
+        if (back != coord)
+            return 255;
+        tools::hilbert<__uint128_t, 3>(&coord[0], &index[0]);
+        tools::unhilbert<__uint128_t, 3>(&index[0], &back[0]);
+        if (back != coord)
+            return 255;
+    }
+
+    std::cout << "cmap with 128-bit coordinates holds " << my_map.size() << " entries" << std::endl;
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <limits>
+
+#include "cmap.hpp"
+#include "quantized_cmap.hpp"
+
+struct data_type
+{
+    uint32_t num;
+};
+
+using qmap    = tools::quantized_cmap<uint16_t, 3, data_type>;
+using octomap = tools::cmap<uint16_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+using point_t = qmap::point_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+bool equal(const octomap& left, const octomap& right)
+{
+    if ((left.size() != right.size()) || (left.num_resizes() != right.num_resizes()))
+        return false;
+    for (const auto& item : left)
+    {
+        auto iter = right.find(item.first);
+        if ((iter == right.end()) || ((*iter).second.num != item.second.num))
+            return false;
+    }
+    return true;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_real_distribution<double> pos(-5.0, 70.0);
+    std::uniform_int_distribution<uint32_t> dt(1, 5);
+
+    const point_t origin = { -1.0, -2.0, -3.0 };
+    const double  cell   = 0.001;
+    qmap my_map(origin, cell);
+    octomap reference;
+
+    for (uint32_t round = 0; round < 3U; ++round)
+    {
+        // Batches with points below the origin, beyond the grid and NaN
+        const size_t number = 50000U;
+        std::vector<double>    points(3U * number);
+        std::vector<data_type> data(number);
+        for (size_t idx = 0; idx < number; ++idx)
+        {
+            for (size_t dim = 0; dim < 3U; ++dim)
+                points[3U * idx + dim] = std::floor(pos(gen) * 100.0) / 100.0;
+            data[idx] = { dt(gen) };
+        }
+        points[7] = std::numeric_limits<double>::quiet_NaN();
+
+        size_t num_rejected = 0U;
+        for (size_t idx = 0; idx < number; ++idx)
+        {
+            const point_t point = { points[3U * idx], points[3U * idx + 1U], points[3U * idx + 2U] };
+            coord_t coord;
+            if (my_map.quantize(point, coord))
+            {
+                reference.insert(coord, data[idx]);
+                const point_t middle = my_map.center(coord);
+                for (size_t dim = 0; dim < 3U; ++dim)
+                    if (std::fabs(middle[dim] - point[dim]) > std::ldexp(cell, reference.num_resizes()))
+                        return 255;
+            }
+            else
+                ++num_rejected;
+        }
+        if ((num_rejected == 0U) || (my_map.insert(points.data(), data.data(), number) != num_rejected))
+            return 255;
+        if (!equal(my_map.map(), reference))
+            return 255;
+
+        my_map.map().resize();
+        reference.resize();
+    }
+
+    // The batch insert of cmap matches single inserts, also into a non-empty map
+    std::uniform_int_distribution<uint16_t> co(0, 200);
+    std::vector<octomap::pair_t> batch;
+    for (uint32_t count = 0; count < 20000U; ++count)
+        batch.push_back({ { co(gen), co(gen), co(gen) }, { dt(gen) } });
+    octomap single, bulk;
+    for (const auto& item : batch)
+        single.insert(item.first, item.second);
+    std::vector<octomap::pair_t> first(batch.begin(), batch.begin() + 10000);
+    std::vector<octomap::pair_t> second(batch.begin() + 10000, batch.end());
+    bulk.insert(first);
+    bulk.insert(second);
+    if (!equal(single, bulk))
+        return 255;
+
+    std::cout << "Quantized map holds " << my_map.map().size() << " cells" << std::endl;
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <thread>
+
+#include "cmap.hpp"
+#include "ingest_cmap.hpp"
+
+struct data_type
+{
+    uint64_t num;
+};
+
+using octomap = tools::cmap<uint32_t, 3, data_type>;
+using ingest  = tools::ingest_cmap<uint32_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+int main()
+{
+    const size_t num_producers = 4U;
+    const size_t number = 50000U;
+
+    // Producer p inserts the records of stream p, which collide with the other streams
+    std::vector<std::vector<std::pair<coord_t, data_type>>> streams(num_producers);
+    octomap reference;
+    for (size_t producer = 0; producer < num_producers; ++producer)
+    {
+        std::mt19937 gen(static_cast<uint32_t>(producer));
+        std::uniform_int_distribution<uint32_t> co(0, 40);
+        std::uniform_int_distribution<uint64_t> dt(1, 5);
+        for (size_t count = 0; count < number; ++count)
+        {
+            streams[producer].push_back({ { co(gen), co(gen), co(gen) }, { dt(gen) } });
+            reference.insert(streams[producer].back().first, streams[producer].back().second);
+        }
+    }
+
+    // A small ring exercises the backpressure
+    ingest my_map(1024U, 4096U);
+    std::vector<std::thread> producers;
+    for (size_t producer = 0; producer < num_producers; ++producer)
+        producers.emplace_back([&, producer]()
+        {
+            for (const auto& record : streams[producer])
+                my_map.insert(record.first, record.second);
+        });
+    for (auto& producer : producers)
+        producer.join();
+    my_map.flush();
+    if (my_map.pending() != 0U)
+        return 255;
+
+    bool same = true;
+    my_map.visit([&](const octomap& map)
+    {
+        same = (map.size() == reference.size());
+        for (const auto& item : reference)
+        {
+            auto iter = map.find(item.first);
+            same = same && (iter != map.end()) && ((*iter).second.num == item.second.num);
+        }
+    });
+    if (!same)
+        return 255;
+
+    // Records enqueued after a flush arrive with the next one
+    const coord_t coord = { 1000U, 1000U, 1000U };
+    if (!my_map.try_insert(coord, { 7U }))
+        return 255;
+    my_map.flush();
+    my_map.visit([&](const octomap& map){ same = map.contains(coord) && (map.size() == reference.size() + 1U); });
+    if (!same)
+        return 255;
+
+    std::cout << "Ingested " << num_producers * number << " records from " << num_producers << " producers" << std::endl;
+    return 0;
+}
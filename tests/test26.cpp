@@ -0,0 +1,159 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "cmap.hpp"
+#include "shards.hpp"
+
+struct data_type
+{
+    uint64_t num;
+
+    bool operator==(const data_type& other) const { return num == other.num; }
+};
+
+using octomap = tools::cmap<uint16_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+int main()
+{
+    const size_t num_shards = 5U;
+    const size_t number = 60000U;
+
+    std::vector<std::pair<coord_t, data_type>> records;
+    std::mt19937 gen(7U);
+    std::uniform_int_distribution<uint16_t> co(0, 65535);
+    std::uniform_int_distribution<uint16_t> cl(0, 30);
+    std::uniform_int_distribution<uint64_t> dt(1, 5);
+    for (size_t count = 0; count < number; ++count)
+    {
+        if (count % 2U == 0U)
+            records.push_back({ { co(gen), co(gen), co(gen) }, { dt(gen) } });
+        else
+            records.push_back({ { cl(gen), cl(gen), cl(gen) }, { dt(gen) } });
+    }
+
+    octomap reference;
+    for (const auto& record : records)
+        reference.insert(record.first, record.second);
+    reference.resize();
+
+    // Every process builds the shard of the records whose resized coordinates fall in its Morton range
+    std::vector<std::string> filenames;
+    std::vector<pid_t> children;
+    for (size_t shard = 0; shard < num_shards; ++shard)
+    {
+        filenames.push_back("cmap_test26_" + std::to_string(getpid()) + "_" + std::to_string(shard) + ".bin");
+        const pid_t child = fork();
+        if (child == 0)
+        {
+            octomap part;
+            for (const auto& record : records)
+            {
+                coord_t coord = record.first;
+                for (auto& value : coord)
+                    value >>= 1U;
+                if (tools::shard_of(coord, num_shards, 1U) == shard)
+                    part.insert(record.first, record.second);
+            }
+            part.resize();
+            _exit(tools::write_shard(part, filenames.back()) ? 0 : 1);
+        }
+        children.push_back(child);
+    }
+    bool written = true;
+    for (const pid_t child : children)
+    {
+        int status = 0;
+        written = written && (waitpid(child, &status, 0) == child) && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+    }
+    if (!written)
+        return 255;
+
+    octomap my_map;
+    const bool merged = tools::merge_shards(filenames, my_map);
+
+    // Shards out of Morton order are refused
+    octomap refused;
+    std::vector<std::string> reversed(filenames.rbegin(), filenames.rend());
+    const bool swapped = tools::merge_shards(reversed, refused);
+
+    // So are shards given twice (their items no longer increase), files of another type, and missing files
+    octomap repeated;
+    const bool twice = tools::merge_shards(std::vector<std::string>{ filenames[0], filenames[0] }, repeated);
+    tools::cmap<uint16_t, 3, uint32_t> other_type;
+    const bool mistyped = tools::merge_shards(std::vector<std::string>{ filenames[0] }, other_type);
+    octomap missing;
+    const bool absent = tools::merge_shards(std::vector<std::string>{ filenames[0] + ".missing" }, missing);
+
+    // And corrupt files: a truncated shard, and a shard whose first byte is flipped
+    const std::string truncated = filenames[0] + ".truncated";
+    const std::string flipped   = filenames[0] + ".flipped";
+    {
+        std::ifstream input(filenames[0], std::ios::in | std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        if (bytes.empty())
+            return 255;
+        std::ofstream short_output(truncated, std::ios::out | std::ios::binary | std::ios::trunc);
+        short_output.write(bytes.data(), bytes.size() - 1U);
+        bytes[0] = static_cast<char>(~bytes[0]);
+        std::ofstream flipped_output(flipped, std::ios::out | std::ios::binary | std::ios::trunc);
+        flipped_output.write(bytes.data(), bytes.size());
+    }
+    octomap cut, garbled;
+    const bool short_read = tools::merge_shards(std::vector<std::string>{ truncated }, cut);
+    const bool corrupt    = tools::merge_shards(std::vector<std::string>{ flipped }, garbled);
+
+    // The merged map round-trips through a single shard
+    const std::string single = "cmap_test26_" + std::to_string(getpid()) + "_all.bin";
+    octomap round_trip;
+    const bool reread = tools::write_shard(my_map, single) && tools::merge_shards(std::vector<std::string>{ single }, round_trip);
+
+    for (const auto& filename : filenames)
+        std::remove(filename.c_str());
+    std::remove(truncated.c_str());
+    std::remove(flipped.c_str());
+    std::remove(single.c_str());
+    if (!merged || swapped || !refused.empty())
+        return 255;
+    if (twice || !repeated.empty() || mistyped || !other_type.empty() || absent || !missing.empty())
+        return 255;
+    if (short_read || !cut.empty() || corrupt || !garbled.empty())
+        return 255;
+    if (!reread || (round_trip != my_map))
+        return 255;
+
+    if ((my_map.size() != reference.size()) || (my_map.num_resizes() != reference.num_resizes()))
+        return 255;
+    for (const auto& item : reference)
+    {
+        auto iter = my_map.find(item.first);
+        if ((iter == my_map.end()) || ((*iter).second.num != item.second.num))
+            return 255;
+    }
+
+    std::cout << "Merged " << num_shards << " shards into " << my_map.size() << " entries" << std::endl;
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <string>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "cmap.hpp"
+#include "shared_cmap.hpp"
+
+struct data_type
+{
+    uint32_t num;
+};
+
+using octomap = tools::cmap<uint32_t, 3, data_type>;
+using shared  = tools::shared_cmap<uint32_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+// Attach to the segment read-only, and compare it with the map
+bool check(const std::string& name, const octomap& my_map, const size_t bytes, const uint32_t seed)
+{
+    const shared image(name);
+    if (!image.valid() || (image.memory() != bytes) || (image.size() != my_map.size()) || (image.num_resizes() != my_map.num_resizes()))
+        return false;
+    for (const auto& pair : my_map)
+    {
+        auto iter = image.find(pair.first);
+        if ((iter == image.end()) || ((*iter).second.num != pair.second.num))
+            return false;
+    }
+
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<uint32_t> co(0, 2000);
+    for (uint32_t count = 0; count < 20000U; ++count)
+    {
+        const coord_t coord = { co(gen), co(gen), co(gen) };
+        if (image.contains(coord) != my_map.contains(coord))
+            return false;
+    }
+
+    const coord_t lower = { co(gen) / 2U, co(gen) / 2U, co(gen) / 2U };
+    const coord_t upper = { lower[0] + 300U, lower[1] + 300U, lower[2] + 300U };
+    size_t inside = 0U;
+    size_t found = 0U;
+    for (const auto& pair : my_map)
+        inside += ((lower[0] <= pair.first[0]) && (pair.first[0] <= upper[0]) && (lower[1] <= pair.first[1]) && (pair.first[1] <= upper[1])
+                && (lower[2] <= pair.first[2]) && (pair.first[2] <= upper[2])) ? 1U : 0U;
+    image.box(lower, upper, [&](const shared::pair_t&){ ++found; });
+    return inside == found;
+}
+
+int main()
+{
+    const size_t num_readers = 3U;
+
+    octomap my_map;
+    std::mt19937 gen(11U);
+    std::uniform_int_distribution<uint32_t> co(0, 1000);
+    std::uniform_int_distribution<uint32_t> dt(1, 9);
+    for (uint32_t count = 0; count < 200000U; ++count)
+        my_map.insert({ co(gen), co(gen), co(gen) }, { dt(gen) });
+    my_map.resize();
+
+    const std::string name = "/cmap_test27_" + std::to_string(getpid());
+    const shared writer(name, my_map);
+    if (!writer.valid() || !check(name, my_map, writer.memory(), 0U))
+        return 255;
+
+    // The name is taken, and other names do not exist
+    const shared taken(name, my_map);
+    const shared missing(name + "_missing");
+    if (taken.valid() || missing.valid())
+    {
+        shared::unlink(name);
+        return 255;
+    }
+
+    std::vector<pid_t> children;
+    for (uint32_t reader = 0; reader < num_readers; ++reader)
+    {
+        const pid_t child = fork();
+        if (child == 0)
+            _exit(check(name, my_map, writer.memory(), reader + 1U) ? 0 : 1);
+        children.push_back(child);
+    }
+    bool same = true;
+    for (const pid_t child : children)
+    {
+        int status = 0;
+        same = same && (waitpid(child, &status, 0) == child) && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+    }
+    if (!shared::unlink(name) || !same)
+        return 255;
+
+    std::cout << num_readers << " readers attached to a segment of " << writer.memory() << " bytes with " << writer.size() << " entries" << std::endl;
+    return 0;
+}
@@ -0,0 +1,101 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "cmap.hpp"
+#include "window_cmap.hpp"
+
+struct data_type
+{
+    uint64_t num;
+};
+
+using window  = tools::window_cmap<uint32_t, 2, data_type>;
+using coord_t = window::coord_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+int main()
+{
+    const size_t num_window = 4U;
+    const size_t num_epochs = 10U;
+    const size_t number = 5000U;
+
+    // Epoch e samples in its own square, overlapping the next one
+    window my_map(num_window, 2U, 1U);
+    std::vector<std::vector<std::pair<coord_t, data_type>>> epochs(num_epochs);
+    std::mt19937 gen(3U);
+    std::uniform_int_distribution<uint32_t> co(0, 150);
+    std::uniform_int_distribution<uint64_t> dt(1, 5);
+    for (size_t epoch = 0; epoch < num_epochs; ++epoch)
+    {
+        if (epoch != 0U)
+            my_map.advance();
+        for (size_t count = 0; count < number; ++count)
+        {
+            epochs[epoch].push_back({ { static_cast<uint32_t>(100U * epoch) + co(gen), static_cast<uint32_t>(100U * epoch) + co(gen) }, { dt(gen) } });
+            my_map.insert(epochs[epoch].back().first, epochs[epoch].back().second);
+        }
+    }
+
+    if ((my_map.epoch() != num_epochs - 1U) || (my_map.num_generations() != num_window))
+        return 255;
+    for (size_t age = 0; age < num_window; ++age)
+    {
+        if (my_map.generation(age).num_resizes() != ((age >= 2U) ? 1U : 0U))
+            return 255;
+    }
+
+    // Merged lookups against the live epochs, at the resolution of each generation
+    for (size_t epoch = 0; epoch < num_epochs; ++epoch)
+    {
+        for (size_t idx = 0; idx < number; idx += 25U)
+        {
+            const coord_t& coord = epochs[epoch][idx].first;
+            bool expected = false;
+            uint64_t total = 0U;
+            for (size_t live = num_epochs - num_window; live < num_epochs; ++live)
+            {
+                const uint8_t shift = (num_epochs - 1U - live >= 2U) ? 1U : 0U;
+                for (const auto& other : epochs[live])
+                {
+                    if (((other.first[0] >> shift) == (coord[0] >> shift)) && ((other.first[1] >> shift) == (coord[1] >> shift)))
+                    {
+                        expected = true;
+                        total += other.second.num;
+                    }
+                }
+            }
+            data_type result = { 0U };
+            if ((my_map.find(coord, result) != expected) || (my_map.contains(coord) != expected) || (expected && (result.num != total)))
+                return 255;
+        }
+    }
+
+    size_t entries = 0U;
+    uint64_t total = 0U;
+    my_map.for_each([&](const coord_t&, const data_type& data, const uint8_t){ ++entries; total += data.num; });
+    uint64_t expected = 0U;
+    for (size_t live = num_epochs - num_window; live < num_epochs; ++live)
+        for (const auto& sample : epochs[live])
+            expected += sample.second.num;
+    if ((entries != my_map.size()) || (total != expected))
+        return 255;
+
+    std::cout << "Window of " << my_map.num_generations() << " generations with " << my_map.size() << " entries in " << my_map.memory() << " bytes" << std::endl;
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <map>
+
+#include "cmap.hpp"
+#include "sketch_cmap.hpp"
+
+using sketch  = tools::sketch_cmap<uint32_t, 3>;
+using coord_t = sketch::coord_t;
+
+int main()
+{
+    const size_t num_heavy = 100U;
+    const size_t max_entries = 2000U;
+    const size_t width = 8192U;
+
+    // A few heavy cells, seen first, and a long tail of light ones
+    std::vector<coord_t> heavy;
+    std::mt19937 gen(5U);
+    std::uniform_int_distribution<uint32_t> co(0, 100000);
+    for (size_t count = 0; count < num_heavy; ++count)
+        heavy.push_back({ co(gen), co(gen), co(gen) });
+
+    sketch my_map(max_entries, width, 4U);
+    std::map<coord_t, uint64_t> reference;
+    std::uniform_int_distribution<uint32_t> pick(0, 3);
+    std::uniform_int_distribution<uint32_t> tail(0, 300);
+    for (size_t count = 0; count < 400000U; ++count)
+    {
+        const coord_t coord = ((count < num_heavy) || (pick(gen) == 0U)) ? heavy[count % num_heavy] : coord_t{ tail(gen), tail(gen), tail(gen) % 4U };
+        my_map.insert(coord, 1U);
+        ++reference[coord];
+        if (my_map.map().size() > max_entries)
+            return 255;
+    }
+    if ((my_map.threshold() == 0U) || (my_map.total() != 400000U))
+        return 255;
+
+    // Heavy cells stay exact
+    for (const auto& coord : heavy)
+    {
+        uint64_t count = 0U;
+        if (!my_map.find(coord, count) || (count != reference[coord]))
+            return 255;
+    }
+
+    // Estimates never underestimate, exact counts are exact, and the error is within the Count-Min bound on average
+    uint64_t error = 0U;
+    for (const auto& item : reference)
+    {
+        uint64_t count = 0U;
+        const bool exact = my_map.find(item.first, count);
+        if ((count < item.second) || (exact && (count != item.second)))
+            return 255;
+        error += count - item.second;
+    }
+    if (error > reference.size() * 2U * my_map.total() / width)
+        return 255;
+
+    std::cout << "Sketched " << reference.size() << " cells in " << my_map.map().size() << " exact entries and " << my_map.memory() << " bytes, mean error "
+              << static_cast<double>(error) / reference.size() << std::endl;
+    return 0;
+}
@@ -15,6 +15,7 @@
 
 #include "cmap.hpp"
 #include "wrap.hpp"
+#include "quantized_cmap.hpp"
 
 struct data_type
 {
@@ -25,6 +26,7 @@ struct data_type
 
 using cmap = tools::cmap<uint32_t, 3, data_type>;
 using wrap = tools::wrap<uint32_t, 3, data_type>;
+using qmap = tools::quantized_cmap<uint32_t, 3, data_type>;
 using coord_t = cmap::coord_t;
 
 void merge(data_type& left, const data_type& right)
@@ -45,8 +47,12 @@ int main()
     std::normal_distribution<double> rad(100000.0, 100.0);
 
     std::vector<std::pair<coord_t, data_type>> buffer;
+    std::vector<double> points;
+    std::vector<data_type> values;
     const size_t number = 1000000U;
     buffer.reserve(number);
+    points.reserve(3U * number);
+    values.reserve(number);
 
     std::cout << "Generating " << number << " samples" << std::endl;
     auto start = std::chrono::system_clock::now();
@@ -56,10 +62,12 @@ int main()
         double phi       = dis(gen) * pi;
         double cos_theta = dis(gen) - 1.0;
         double sin_theta = sin(acos(cos_theta));
+        points.insert(points.end(), { radius * sin_theta * cos(phi), radius * sin_theta * sin(phi), radius * cos_theta });
         uint32_t x = static_cast<uint32_t>(center + radius * sin_theta * cos(phi) + 0.5);
         uint32_t y = static_cast<uint32_t>(center + radius * sin_theta * sin(phi) + 0.5);
         uint32_t z = static_cast<uint32_t>(center + radius * cos_theta + 0.5);
         buffer.push_back({{ x, y, z }, { dis(gen), dis(gen), dis(gen) }});
+        values.push_back(buffer.back().second);
     }
     auto stop = std::chrono::system_clock::now();
     auto time = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
@@ -85,6 +93,17 @@ int main()
         std::cout << "Performed " << static_cast<uint32_t>(my_cmap.num_resizes()) << " cmap resizes" << std::endl;
     }
 
+    {
+        qmap my_qmap({ -center - 0.5, -center - 0.5, -center - 0.5 }, 1.0);
+        start = std::chrono::system_clock::now();
+        const size_t num_rejected = my_qmap.insert(points.data(), values.data(), number);
+        stop = std::chrono::system_clock::now();
+        time = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+        std::cout << "Quantizing and inserting in batch   : " << 1e-3 * time << " s." << std::endl;
+        if (num_rejected != 0U)
+            return 255;
+    }
+
     {
         wrap my_wrap;
         start = std::chrono::system_clock::now();
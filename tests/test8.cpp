@@ -0,0 +1,145 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <map>
+
+#include "cmap.hpp"
+
+struct data_type
+{
+    uint32_t num;
+    uint32_t sum;
+};
+
+using octomap = tools::cmap<uint16_t, 3, data_type>;
+using coord_t = octomap::coord_t;
+using   map_t = std::map<coord_t, data_type>;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+    left.sum  = 2U * left.sum + right.sum; // Not commutative: checks the order of merge(left, right)
+}
+
+void fill(octomap& my_map, map_t& std_map, std::mt19937& gen, const uint16_t offset)
+{
+    std::uniform_int_distribution<uint16_t> dense(0, 7);
+    std::uniform_int_distribution<uint16_t> sparse(0, 1023);
+    std::uniform_int_distribution<uint32_t> dt(1, 16);
+
+    for (uint32_t count = 0; count < 3000U; ++count)
+    {
+        coord_t coord = (count & 1U) ? coord_t{ static_cast<uint16_t>(offset + dense(gen)), dense(gen), dense(gen) }
+                                     : coord_t{ sparse(gen), sparse(gen), sparse(gen) };
+        data_type data = { 1U, dt(gen) };
+        my_map.insert(coord, data);
+        auto iter = std_map.find(coord);
+        if (iter == std_map.end())
+            std_map[coord] = data;
+        else
+            merge((*iter).second, data);
+    }
+}
+
+bool equal(const octomap& my_map, const map_t& std_map)
+{
+    if (my_map.size() != std_map.size())
+        return false;
+    size_t count = 0U;
+    for (const auto& pair : my_map)
+    {
+        auto iter = std_map.find(pair.first);
+        if ((iter == std_map.end()) || ((*iter).second.num != pair.second.num) || ((*iter).second.sum != pair.second.sum))
+            return false;
+        ++count;
+    }
+    return count == std_map.size();
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+
+    {
+        octomap signal, background;
+        map_t std_signal, std_background;
+        fill(signal,     std_signal,     gen, 0);
+        fill(background, std_background, gen, 4);
+
+        for (const auto& pair : std_background)
+        {
+            auto iter = std_signal.find(pair.first);
+            if (iter == std_signal.end())
+                std_signal[pair.first] = pair.second;
+            else
+                merge((*iter).second, pair.second);
+        }
+
+        signal.merge_union(background);
+        std::cout << "Union: size = " << signal.size() << std::endl;
+        if (!equal(signal, std_signal))
+            return 255;
+        if (!background.empty() || (background.begin() != background.end()))
+            return 253;
+    }
+
+    {
+        octomap signal, background;
+        map_t std_signal, std_background;
+        fill(signal,     std_signal,     gen, 0);
+        fill(background, std_background, gen, 4);
+
+        map_t std_result;
+        for (const auto& pair : std_signal)
+        {
+            auto iter = std_background.find(pair.first);
+            if (iter != std_background.end())
+            {
+                std_result[pair.first] = pair.second;
+                merge(std_result[pair.first], (*iter).second);
+            }
+        }
+
+        const size_t num_removed = signal.intersect(background, [](data_type& left, const data_type& right){ merge(left, right); });
+        std::cout << "Intersection: size = " << signal.size() << " after removing " << num_removed << std::endl;
+        if (num_removed != std_signal.size() - std_result.size())
+            return 251;
+        if (!equal(signal, std_result))
+            return 249;
+        if (!equal(background, std_background))
+            return 247;
+    }
+
+    {
+        octomap signal, background;
+        map_t std_signal, std_background;
+        fill(signal,     std_signal,     gen, 0);
+        fill(background, std_background, gen, 4);
+
+        size_t std_removed = 0U;
+        for (const auto& pair : std_background)
+            std_removed += std_signal.erase(pair.first);
+
+        const size_t num_removed = signal.difference(background);
+        std::cout << "Difference: size = " << signal.size() << " after removing " << num_removed << std::endl;
+        if (num_removed != std_removed)
+            return 245;
+        if (!equal(signal, std_signal))
+            return 243;
+    }
+
+    return 0;
+}
+
+
@@ -0,0 +1,119 @@
+/*
+    cmap is a resizable coordinate map
+
+    Copyright (c) 2020, Sebastian Wouters
+    All rights reserved.
+
+    This file is part of cmap, licensed under the BSD 3-Clause License.
+    A copy of the License can be found in the file LICENSE in the root
+    folder of this project.
+*/
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <set>
+
+#include "cmap.hpp"
+
+struct data_type
+{
+    uint32_t num;
+
+    bool operator==(const data_type& other) const { return num == other.num; }
+};
+
+using quadmap = tools::cmap<uint16_t, 4, data_type>;
+using coord_t = quadmap::coord_t;
+using  pair_t = quadmap::pair_t;
+
+void merge(data_type& left, const data_type& right)
+{
+    left.num += right.num;
+}
+
+int main()
+{
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<uint16_t> co(0, 31);
+    std::uniform_int_distribution<uint32_t> dt(1, 1024);
+
+    std::vector<pair_t> samples;
+    std::set<coord_t> unique;
+    while (samples.size() < 5000U)
+    {
+        coord_t coord = { co(gen), co(gen), co(gen), co(gen) };
+        if (unique.insert(coord).second)
+            samples.push_back({ coord, { dt(gen) } });
+    }
+
+    quadmap replica1, replica2;
+    for (const auto& sample : samples)
+        replica1.insert(sample.first, sample.second);
+    for (auto iter = samples.rbegin(); iter != samples.rend(); ++iter) // Different insertion order
+        replica2.insert((*iter).first, (*iter).second);
+
+    if (!(replica1 == replica2) || (replica1 != replica2))
+        return 255;
+
+    size_t num_diff = 0U;
+    diff(replica1, replica2, [&](const pair_t&){ ++num_diff; }, [&](const pair_t&){ ++num_diff; }, [&](const pair_t&, const pair_t&){ ++num_diff; });
+    if (num_diff != 0U)
+        return 253;
+
+    // Added in replica2: outside of the sampled region
+    const coord_t added = { 1000, 1000, 1000, 1000 };
+    replica2.insert(added, { 7U });
+    // Removed in replica2
+    const coord_t removed = samples[0].first;
+    replica2.erase(removed);
+    // Changed in replica2
+    const coord_t changed = samples[1].first;
+    replica2.insert(changed, { 3U });
+
+    if (replica1 == replica2)
+        return 251;
+
+    size_t num_added = 0U, num_removed = 0U, num_changed = 0U;
+    diff(replica1, replica2,
+        [&](const pair_t& item)
+        {
+            std::cout << "Added   : { " << item.first[0] << ", " << item.first[1] << ", " << item.first[2] << ", " << item.first[3] << " }" << std::endl;
+            num_added += (item.first == added) ? 1U : 1000U;
+        },
+        [&](const pair_t& item)
+        {
+            std::cout << "Removed : { " << item.first[0] << ", " << item.first[1] << ", " << item.first[2] << ", " << item.first[3] << " }" << std::endl;
+            num_removed += (item.first == removed) ? 1U : 1000U;
+        },
+        [&](const pair_t& left, const pair_t& right)
+        {
+            std::cout << "Changed : { " << left.first[0] << ", " << left.first[1] << ", " << left.first[2] << ", " << left.first[3] << " } from "
+                      << left.second.num << " to " << right.second.num << std::endl;
+            num_changed += ((left.first == changed) && (right.second.num == left.second.num + 3U)) ? 1U : 1000U;
+        });
+
+    if ((num_added != 1U) || (num_removed != 1U) || (num_changed != 1U))
+        return 249;
+
+    // Structure differs after erasing, but the content is the same again
+    quadmap replica3;
+    for (const auto& sample : samples)
+        replica3.insert(sample.first, sample.second);
+    for (uint32_t count = 2U; count < 4000U; ++count)
+        replica3.erase(samples[count].first);
+    for (uint32_t count = 2U; count < 4000U; ++count)
+        replica3.insert(samples[count].first, samples[count].second);
+    if (replica1 != replica3)
+        return 247;
+
+    replica1.resize();
+    replica3.resize();
+    if (replica1 != replica3)
+        return 245;
+
+    return 0;
+}
+
+